@@ -35,11 +35,11 @@
 #include "util/delay.h"
 #include "stepper.h"
 
-stepper_position_t MainMove(stepper_position_t position, stepper_position_t displacement, uint16_t count_delay)
+stepper_position_t MainMove(stepper_position_t position, stepper_position_t displacement, uint16_t count)
 {
     printf("\n\rInitial position:\t%.2f steps / %ld sub-steps", SUBSTEPS_TO_STEPS(position), position);
-    printf("\n\rMoving with speed:\t%.3f revolutions/second", COUNT_TO_RPS(count_delay));
-    position = Stepper_Move(position, displacement, count_delay);
+    printf("\n\rMoving with speed:\t%.3f revolutions/second", COUNT_TO_RPS(count));
+    position = Stepper_Move(position, displacement, count);
     printf("\n\rFinal position: \t%.2f steps / %ld sub-steps", SUBSTEPS_TO_STEPS(position), position);
     printf("\n\r");
     return position;
@@ -53,6 +53,9 @@ int main(void)
     /* System initialize */
     SYSTEM_Initialize();
 
+    /*Register the Stepper_TimeTick as a callback*/
+    TCE0_OverflowCallbackRegister(Stepper_TimeTick);
+
     Stepper_Init();
     
     _delay_ms(2000);
@@ -63,22 +66,22 @@ int main(void)
     while(1)
     {
         stepper_position_t sub_steps;
-        uint16_t           count_delay;
+        uint16_t           count;
 
         sub_steps = STEPS_TO_SUBSTEPS(1000);        /* Positive: CW, Negative: CCW */
-        count_delay = RPS_TO_COUNT(1.0);            /* revolutions per second */
+        count = RPS_TO_COUNT(1.0);                  /* revolutions per second */
 
         stepper_position = MainMove(stepper_position,
                                     sub_steps,
-                                    count_delay);
+                                    count);
         _delay_ms(1000);
         
         sub_steps = -STEPS_TO_SUBSTEPS(2000);       /* Positive: CW, Negative: CCW */
-        count_delay = RPS_TO_COUNT(2.0);            /* revolutions per second */
+        count = RPS_TO_COUNT(2.0);                  /* revolutions per second */
 
         stepper_position = MainMove(stepper_position,
                                     sub_steps,
-                                    count_delay);
+                                    count);
         _delay_ms(1000);
     }
 }
@@ -2,6 +2,7 @@
 #define STEPPER_H
 
 
+#include <stdbool.h>
 #include <stdint.h>
 
 
@@ -48,13 +49,14 @@ typedef int32_t  stepper_position_t;
 #endif 
 
 
-#define Q_DELAY         24                      /* Microseconds */
-#define OVERHEAD_DELAY  3
+/*PWM Interrupt Interval */
+#define TICK_INTERVAL   50.0                    /* Microseconds */
 
 
-/* Convert revolutions/second into count and inverse */
-#define RPS_TO_COUNT(REVPS)                     (uint16_t)((1000000.0 / ((Q_DELAY + OVERHEAD_DELAY) * (360.0 / STEP_SIZE) * K_MODE * (REVPS))) + 0.5) /* count */
-#define COUNT_TO_RPS(COUNT)                                (1000000.0 / ((Q_DELAY + OVERHEAD_DELAY) * (360.0 / STEP_SIZE) * K_MODE * (COUNT)))        /* rev/s */
+/* Convert revolutions/second into count and inverse
+ * The count is the step rate in sub-steps per tick, 65536 being one sub-step per tick, so the highest speed is one sub-step every TICK_INTERVAL */
+#define RPS_TO_COUNT(REVPS)                     (uint16_t)(((REVPS) * (360.0 / STEP_SIZE) * K_MODE * TICK_INTERVAL * 65536.0) / 1000000.0 + 0.5) /* count */
+#define COUNT_TO_RPS(COUNT)                     (((COUNT) * 1000000.0) / ((360.0 / STEP_SIZE) * K_MODE * TICK_INTERVAL * 65536.0))              /* rev/s */
 
 
 /* Converts steps into substeps */
@@ -65,13 +67,21 @@ typedef int32_t  stepper_position_t;
 /* Function Prototypes*/
 /* params:
     steps: if negative, then go CCW, if positive - go CW
-    acceleration, deceleration: steps / s^2
-    speed: steps/s
-    vbus: vbus expressed in mV
+    count: step rate, see RPS_TO_COUNT
 
   returns: new position of the stepper motor
 */
 stepper_position_t Stepper_Move(stepper_position_t, stepper_position_t, uint16_t);
+void               Stepper_TimeTick(void);  /* Called periodically from interrupt context */
 void               Stepper_Init(void);
 
+/* Non-blocking interface. The movement is executed by Stepper_TimeTick.
+   Stepper_MoveStart takes the same parameters as Stepper_Move, without the initial position.
+   returns: false if a movement is in progress
+*/
+bool               Stepper_MoveStart(stepper_position_t, uint16_t);
+bool               Stepper_IsBusy(void);
+stepper_position_t Stepper_GetPosition(void);
+void               Stepper_PositionSet(stepper_position_t);
+
 #endif /*  STEPPER_H  */
\ No newline at end of file
@@ -39,6 +39,11 @@
 #include "../tce0.h"
 
 
+/**
+ * @ingroup tce0
+ * @brief Function pointers that store the callback addresses.
+ */
+static TCE0_cb_t TCE0_OVF_isr_cb  = NULL;
 
 /**
  * @ingroup tce0
@@ -52,16 +57,40 @@ static volatile bool timerActive = false;
  */
 static volatile uint8_t timerMode = TCE_WGMODE_FRQ_gc;
 
+/**
+ * @ingroup tce0
+ * @brief Interrupt Service Routine (ISR) for the overflow (OVF) interrupt.
+ * @param None.
+ * @return None.
+ */
+ISR(TCE0_OVF_vect)
+{
+    TCE0.INTFLAGS = TCE_OVF_bm;
+    if (TCE0_OVF_isr_cb != NULL)
+    {
+        TCE0_OVF_isr_cb();
+    }
+}
+
+
+void TCE0_OverflowCallbackRegister(TCE0_cb_t callback)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TCE0_OVF_isr_cb = callback;
+    }
+}
 
 
 void TCE0_Initialize(void)
 {
     timerMode = TCE_WGMODE_SINGLESLOPE_gc;
 
+    TCE0_OVF_isr_cb  = NULL;
 
     TCE0.CTRLA = 0x00;
-    // CMP0 disabled; CMP1 disabled; CMP2 disabled; CMP3 disabled; OVF disabled; 
-    TCE0.INTCTRL = 0x0;
+    // CMP0 disabled; CMP1 disabled; CMP2 disabled; CMP3 disabled; OVF enabled; 
+    TCE0.INTCTRL = 0x1;
     // ALUPD disabled; CMP0EN enabled; CMP1EN enabled; CMP2EN enabled; CMP3EN enabled; WGMODE SINGLESLOPE; 
     TCE0.CTRLB = 0xF3;
     // CMP0OV disabled; CMP0POL disabled; CMP1OV disabled; CMP1POL disabled; CMP2OV disabled; CMP2POL disabled; CMP3OV disabled; CMP3POL disabled; 
@@ -133,6 +162,7 @@ void TCE0_Deinitialize(void)
     TCE0.CMP2      = 0x0000;
     TCE0.CMP3      = 0x0000;
 
+    TCE0_OVF_isr_cb  = NULL;
 
     timerActive = false;
 
@@ -89,6 +89,13 @@
  */
 #define TCE0_HZ_TO_CLOCKS_FREQUENCYMODE(HZ, F_CLOCK, TCE_PRESCALER)(uint16_t)((float)(F_CLOCK) / (2 * (float)(HZ) * (float)(TCE_PRESCALER)) - 1)
 
+/**
+ * @ingroup tce0
+ * @brief Pointer to a function to be used as a callback handler when an overflow interrupt event occurs.
+ * @param None.
+ * @return None.
+ */
+typedef void (* TCE0_cb_t)(void);
 
 
 /**
@@ -102,6 +109,15 @@ typedef enum
 }
 TCE0_status_t;
 
+/**
+ * @ingroup tce0
+ * @brief Setter function for the TCE0 overflow callback.
+ * @pre None.
+ * @param callback Pointer to custom callback.
+ * @return None.
+ */
+void TCE0_OverflowCallbackRegister(TCE0_cb_t callback);
+
 
 /**
  * @ingroup tce0
@@ -1,209 +1,90 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <util/atomic.h>
 #include "mcc_generated_files/timer/tce0.h"
-
-#define F_CPU 20000000UL
-#include "util/delay.h"
 #include "stepper.h"
 
 
+/* Coil drive lookup
+ * The electrical angle is a single index with 4 * COIL_RES entries per electrical period (4 full-steps).
+ * In every quarter of the period one channel is driven with coil_table[s] (sine) and another one with
+ * coil_table[COIL_COS_BASE - s] (cosine), s being the position inside the quarter. The other two channels are zero. */
+#if STEPPING_MODE == FULL_STEP
+#define COIL_RES        1
+#define COIL_COS_BASE   0
+static const uint16_t coil_table[COIL_RES] = { DRIVE_FULL };
+#endif /* STEPPING_MODE == FULL_STEP */
+
+#if STEPPING_MODE == HALF_STEP
+#define COIL_RES        2
+#define COIL_COS_BASE   2
+static const uint16_t coil_table[COIL_RES + 1] = { DRIVE_ZERO, DRIVE_HALF, DRIVE_FULL };
+#endif /* STEPPING_MODE == HALF_STEP */
+
 #if STEPPING_MODE == MICROSTEP
-static const uint16_t sine_lookup_table[32] = 
-{
-    AMP_TO_U16(0.024541229),
-    AMP_TO_U16(0.073564564),
-    AMP_TO_U16(0.122410675),
-    AMP_TO_U16(0.170961889),
-    AMP_TO_U16(0.21910124),
-    AMP_TO_U16(0.266712757),
-    AMP_TO_U16(0.31368174),
-    AMP_TO_U16(0.359895037),
-    AMP_TO_U16(0.405241314),
-    AMP_TO_U16(0.44961133),
-    AMP_TO_U16(0.492898192),
-    AMP_TO_U16(0.53499762),
-    AMP_TO_U16(0.575808191),
-    AMP_TO_U16(0.615231591),
-    AMP_TO_U16(0.653172843),
-    AMP_TO_U16(0.689540545),
-    AMP_TO_U16(0.724247083),
-    AMP_TO_U16(0.757208847),
-    AMP_TO_U16(0.788346428),
-    AMP_TO_U16(0.817584813),
-    AMP_TO_U16(0.844853565),
-    AMP_TO_U16(0.870086991),
-    AMP_TO_U16(0.893224301),
-    AMP_TO_U16(0.914209756),
-    AMP_TO_U16(0.932992799),
-    AMP_TO_U16(0.949528181),
-    AMP_TO_U16(0.963776066),
-    AMP_TO_U16(0.97570213),
-    AMP_TO_U16(0.985277642),
-    AMP_TO_U16(0.992479535),
-    AMP_TO_U16(0.997290457),
-    AMP_TO_U16(0.999698819)
-};
-#else /* STEPPING_MODE */
-typedef enum
-{
-    CW_STEP_0 = 0,
-    CW_STEP_45 = 1,
-    CW_STEP_90 = 2,
-    CW_STEP_135 = 3,
-    CW_STEP_180 = 4,
-    CW_STEP_225 = 5,
-    CW_STEP_270 = 6,
-    CW_STEP_315 = 7,
-    
-    
-    CCW_STEP_0 = 8,
-    CCW_STEP_45 = 9,
-    CCW_STEP_90 = 10,
-    CCW_STEP_135 = 11,
-    CCW_STEP_180 = 12,
-    CCW_STEP_225 = 13,
-    CCW_STEP_270 = 14,
-    CCW_STEP_315 = 15
-} step_t;
-#endif /* STEPPING_MODE  */
-
-
-/* This function controls the speed of the stepper */
-static void Variable_Delay(uint16_t count)
-{
-    volatile uint16_t _count = count;
-    
-    while(_count >  0)
-    {
-        _delay_us(Q_DELAY);
-        _count--;
-    }
-}
+/* K_MODE entries of sin((i + 0.5) * 90 / K_MODE degrees), generated at compile time. K_MODE must be a power of two up to 256. */
+#define COIL_RES        K_MODE
+#define COIL_COS_BASE   (COIL_RES - 1)
+
+#define SINE_PI                                 3.14159265358979
+#define SINE_ENTRY(i)                           AMP_TO_U16(__builtin_sin(((i) + 0.5) * SINE_PI / (2.0 * COIL_RES))),
+#define SINE_REP1(i)                            SINE_ENTRY(i)
+#define SINE_REP2(i)                            SINE_REP1(i)   SINE_REP1((i) + 1)
+#define SINE_REP4(i)                            SINE_REP2(i)   SINE_REP2((i) + 2)
+#define SINE_REP8(i)                            SINE_REP4(i)   SINE_REP4((i) + 4)
+#define SINE_REP16(i)                           SINE_REP8(i)   SINE_REP8((i) + 8)
+#define SINE_REP32(i)                           SINE_REP16(i)  SINE_REP16((i) + 16)
+#define SINE_REP64(i)                           SINE_REP32(i)  SINE_REP32((i) + 32)
+#define SINE_REP128(i)                          SINE_REP64(i)  SINE_REP64((i) + 64)
+#define SINE_REP256(i)                          SINE_REP128(i) SINE_REP128((i) + 128)
+#define SINE_TABLE_(n)                          SINE_REP##n(0)
+#define SINE_TABLE(n)                           SINE_TABLE_(n)
+
+static const uint16_t coil_table[COIL_RES] = { SINE_TABLE(K_MODE) };
+#endif /* STEPPING_MODE == MICROSTEP */
+
+#define COIL_INDEX_MASK                         (4 * COIL_RES - 1)
+
+/* Channels (0: a, 1: b, 2: c, 3: d) driven with the sine and with the cosine in each quarter of the electrical period */
+static const uint8_t sine_channel[4]   = { 3, 0, 2, 1 };
+static const uint8_t cosine_channel[4] = { 1, 3, 0, 2 };
+
+
+/* Motion state. A movement is set up by Stepper_MoveStart and run by the TCE0 tick while moving is true. */
+static volatile bool       moving;
+static stepper_position_t  actual_position;
+static uint32_t            steps_to_go;
+static uint16_t            step_rate;
+static uint16_t            step_phase;
+static bool                direction;
 
 /* If parameter direction is True means that motor will spin in CCW */
 static void StepAdvance(bool direction)
 {  
-    uint16_t a = 0, b = 0, c = 0, d = 0;
+    static uint16_t step = 0;
+    uint16_t channel[4] = { DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO };
+    uint8_t  quarter;
+    uint16_t s;
 
-#if STEPPING_MODE == FULL_STEP    
-    static step_t step = 0;
-    /*These masks are correlated with step_t */
-    step &= 7;
-    if(direction) step |= 8;
+    /* CW: +1, CCW: -1 on the same index, so the electrical angle stays continuous when the direction changes */
+    step = (step + 1 - 2 * (uint16_t)direction) & COIL_INDEX_MASK;
+    quarter = (uint8_t)(step / COIL_RES);
+    s = step & (COIL_RES - 1);
 
-    switch(step)
-    {
-        case CW_STEP_270:   a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CW_STEP_180;     break;
-        case CW_STEP_180:   a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CW_STEP_90;      break;
-        case CW_STEP_90:    a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_FULL; d = DRIVE_ZERO; step = 0;               break;
-        case CW_STEP_0:     a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_FULL; step = CW_STEP_270;     break;
+    channel[sine_channel[quarter]]   = coil_table[s];
+    channel[cosine_channel[quarter]] = coil_table[COIL_COS_BASE - s];
 
-        case CCW_STEP_0:    a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_FULL; step = CCW_STEP_90;     break;                  
-        case CCW_STEP_90:   a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_FULL; d = DRIVE_ZERO; step = CCW_STEP_180;    break;
-        case CCW_STEP_180:  a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CCW_STEP_270;    break;
-        case CCW_STEP_270:  a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CCW_STEP_0;      break;
-
-        default:            a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_0;       break; 
-    }   
-#endif /* STEPPING_MODE==FULL_STEP */
-
-#if STEPPING_MODE == HALF_STEP
-    static step_t step = 0;
-    /*These masks are correlated with step_t */
-    step &= 7;
-    if(direction) step |= 8;
-    
-    switch(step)
-    {
-        case CW_STEP_315:  a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_ZERO; d = DRIVE_HALF; step = CW_STEP_270;      break;  
-        case CW_STEP_270:  a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CW_STEP_225;      break;
-        case CW_STEP_225:  a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_HALF; step = CW_STEP_180;      break;
-        case CW_STEP_180:  a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_135;      break;
-        case CW_STEP_135:  a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_HALF; d = DRIVE_ZERO; step = CW_STEP_90;       break;
-        case CW_STEP_90:   a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CW_STEP_45;       break;
-        case CW_STEP_45:   a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_HALF; d = DRIVE_ZERO; step = CW_STEP_0;        break;
-        case CW_STEP_0:    a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_315;      break;  
-        
-        case CCW_STEP_0:   a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CCW_STEP_45;      break;                  
-        case CCW_STEP_45:  a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_HALF; d = DRIVE_ZERO; step = CCW_STEP_90;      break;
-        case CCW_STEP_90:  a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CCW_STEP_135;     break;
-        case CCW_STEP_135: a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_HALF; d = DRIVE_ZERO; step = CCW_STEP_180;     break;
-        case CCW_STEP_180: a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CCW_STEP_225;     break;                  
-        case CCW_STEP_225: a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_HALF; step = CCW_STEP_270;     break;
-        case CCW_STEP_270: a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CCW_STEP_315;     break;
-        case CCW_STEP_315: a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_ZERO; d = DRIVE_HALF; step = CCW_STEP_0;       break;
-        
-        default:           a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_0;        break;               
-    }    
-#endif /* STEPPING_MODE==HALF_STEP */
-    
-#if STEPPING_MODE == MICROSTEP
-    static uint8_t step = 0;
-    uint8_t x = (step & 0x60) | direction;
-       
-    switch(x)
-    {
-        /* CW */
-        case 0x00:  a = 0;
-                    b = sine_lookup_table[31 - (step & 0x1F)];
-                    c = 0;
-                    d = sine_lookup_table[step & 0x1F];;
-                    break;
-        case 0x20: 
-                    a = sine_lookup_table[step & 0x1F];
-                    b = 0;
-                    c = 0;
-                    d = sine_lookup_table[31 - (step & 0x1F)];
-                    break;
-        case 0x40:            
-                    a = sine_lookup_table[31 - (step & 0x1F)];
-                    b = 0;
-                    c = sine_lookup_table[step & 0x1F];;
-                    d = 0;
-                    break;     
-        case 0x60: 
-                    a = 0;
-                    b = sine_lookup_table[step & 0x1F];
-                    c = sine_lookup_table[31 - (step & 0x1F)];
-                    d = 0;                  
-                    break;
-        
-        /* CCW */
-        case 0x01: 
-                    a = 0;
-                    b = sine_lookup_table[31 - (step & 0x1F)];
-                    c = sine_lookup_table[step & 0x1F];
-                    d = 0;                  
-                    break;
-        case 0x21: 
-                    a = sine_lookup_table[step & 0x1F];
-                    b = 0;
-                    c = sine_lookup_table[31 - (step & 0x1F)];
-                    d = 0;          
-                    break;
-        case 0x41: 
-                    a = sine_lookup_table[31 - (step & 0x1F)];
-                    b = 0;
-                    c = 0;
-                    d = sine_lookup_table[step & 0x1F];            
-                    break;
-        case 0x61:           
-                    a = 0;
-                    b = sine_lookup_table[step & 0x1F];
-                    c = 0;
-                    d = sine_lookup_table[31 - (step & 0x1F)];            
-                    break;
-                    
-        default:   a = 0; b = 0; c = 0; d = 0; break;           
-    }
-    step++; step &= 0x7F;
-#endif /* STEPPING_MODE == MICRO_STEP */
-    TCE0_CompareAllChannelsBufferedSet(a, b, c, d);
+    TCE0_CompareAllChannelsBufferedSet(channel[0], channel[1], channel[2], channel[3]);
 }
 
 
 void Stepper_Init(void)
 {
+    moving = false;
+    actual_position = 0;
+    steps_to_go = 0;
+    step_rate = 0;
+    step_phase = 0;
     /* Enable hardware scaling accelerator after initialization */
     TCE0_ScaleEnable(true);
     TCE0_AmplitudeSet(DRIVE_ZERO);
@@ -217,12 +98,45 @@ static inline void AmplitudeSet(uint16_t amplitude)
     TCE0_AmplitudeSet(amplitude);
 }
 
-stepper_position_t Stepper_Move(stepper_position_t initial_position, stepper_position_t steps, uint16_t delay)
-{  
-    stepper_position_t actual_position = initial_position;
-    bool direction;
-    uint32_t steps_to_go;
+/* This function is registered as a callback and must be called once in TICK_INTERVAL.
+ * The step rate is added to a 16-bit phase every tick and a sub-step is made when the phase wraps,
+ * so the average step period is exact and depends only on the timer, not on the code execution time. */
+void Stepper_TimeTick(void)
+{
+    if(moving == false)
+        return;
+
+    step_phase += step_rate;
+    if(step_phase >= step_rate)
+        return;
+
+    steps_to_go--;
+    StepAdvance(direction);
+    if(direction) actual_position--;
+    else          actual_position++;
+
+    if(steps_to_go == 0)
+    {
+        /* Movement completed. Now the motor is stopped. */
+        AmplitudeSet(AMPLITUDE_STALL);
+
+#if (RELEASE_IN_IDLE == true)
+        /* Release the current through coils */
+        TCE0_CompareAllChannelsBufferedSet(DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO);
+#endif /* RELEASE_IN_IDLE */
+        moving = false;
+    }
+}
+
+bool Stepper_MoveStart(stepper_position_t steps, uint16_t rate)
+{
+    if(moving)
+        return false;
 
+    if((steps == 0) || (rate == 0))
+        return true;
+
+    /* The tick does not touch the motion state until moving is set */
     if(steps < 0)
     {
         direction = true;
@@ -233,26 +147,46 @@ stepper_position_t Stepper_Move(stepper_position_t initial_position, stepper_pos
         direction = false;
         steps_to_go = (uint32_t)steps;
     }
-        
+    step_rate = rate;
+    step_phase = 0;
+
     AmplitudeSet(AMPLITUDE_DRIVE);
-    
-    /* Now start moving */
-    while(steps_to_go != 0)
+    moving = true;
+    return true;
+}
+
+bool Stepper_IsBusy(void)
+{
+    return moving;
+}
+
+stepper_position_t Stepper_GetPosition(void)
+{
+    stepper_position_t position;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        Variable_Delay(delay);
+        position = actual_position;
+    }
+    return position;
+}
 
-        steps_to_go--;
-        StepAdvance(direction);
-        if(direction) actual_position--;
-        else          actual_position++;
+void Stepper_PositionSet(stepper_position_t position)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        actual_position = position;
     }
-    /* Movement completed. Now the motor is stopped. */
-    AmplitudeSet(AMPLITUDE_STALL);
-    
-#if (RELEASE_IN_IDLE == true)
-    /* Release the current through coils */
-    TCE0_CompareAllChannelsBufferedSet(DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO);
-#endif /* RELEASE_IN_IDLE */
-    
-    return actual_position;
-}
\ No newline at end of file
+}
+
+stepper_position_t Stepper_Move(stepper_position_t initial_position, stepper_position_t steps, uint16_t rate)
+{
+    while(Stepper_IsBusy());
+
+    Stepper_PositionSet(initial_position);
+    Stepper_MoveStart(steps, rate);
+
+    while(Stepper_IsBusy());
+
+    return Stepper_GetPosition();
+}
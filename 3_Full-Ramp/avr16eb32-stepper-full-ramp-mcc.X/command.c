@@ -0,0 +1,203 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <util/crc16.h>
+#include "mcc_generated_files/uart/usart0.h"
+#include "stepper.h"
+#include "command.h"
+
+
+#define COMMAND_HEADER_SIZE                     3       /* SOF, command, length */
+#define COMMAND_CRC_SIZE                        2
+
+/* Frame bytes are read in place from the receive buffer, offset 0 being the SOF */
+#define FRAME_U8(offset)                        USART0_RxPeek(offset)
+#define PAYLOAD_U8(offset)                      FRAME_U8(COMMAND_HEADER_SIZE + (offset))
+
+/* Movement parameters set by COMMAND_SET_PARAMS */
+static uint16_t            acceleration;
+static uint16_t            deceleration;
+static uint16_t            speed_limit;
+
+/* Position reached at the end of the queued movements. Not known while a jog or a stop is in progress. */
+static stepper_position_t  end_position;
+static bool                end_known;
+
+static uint16_t PayloadU16(uint8_t offset)
+{
+    return (uint16_t)PAYLOAD_U8(offset) | ((uint16_t)PAYLOAD_U8(offset + 1) << 8);
+}
+
+static uint32_t PayloadU32(uint8_t offset)
+{
+    return (uint32_t)PayloadU16(offset) | ((uint32_t)PayloadU16(offset + 2) << 16);
+}
+
+/* Sends a frame through the USART0 transmit buffer */
+static void ReplySend(uint8_t command, const uint8_t *data, uint8_t length)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t  k;
+
+    crc = _crc_ccitt_update(crc, command);
+    crc = _crc_ccitt_update(crc, length);
+    for(k = 0; k < length; k++)
+        crc = _crc_ccitt_update(crc, data[k]);
+
+    USART0_Write(COMMAND_SOF);
+    USART0_Write(command);
+    USART0_Write(length);
+    for(k = 0; k < length; k++)
+        USART0_Write(data[k]);
+    USART0_Write((uint8_t)crc);
+    USART0_Write((uint8_t)(crc >> 8));
+}
+
+static uint8_t MoveTo(stepper_position_t target, uint16_t vbus_mv)
+{
+    stepper_position_t start;
+
+    if(Stepper_IsBusy() == false)
+    {
+        start = Stepper_GetPosition();
+    }
+    else if(end_known)
+    {
+        start = end_position;
+    }
+    else
+    {
+        return COMMAND_STATUS_BUSY;
+    }
+
+    if(Stepper_MoveStart(target - start, acceleration, deceleration, speed_limit, vbus_mv) == false)
+        return COMMAND_STATUS_BUSY;
+
+    end_position = target;
+    end_known = true;
+    return COMMAND_STATUS_OK;
+}
+
+static uint8_t Jog(uint8_t jog_direction, uint16_t speed, uint16_t vbus_mv)
+{
+    if(jog_direction > 1)
+        return COMMAND_STATUS_VALUE;
+
+    /* Also while moving or jogging: the motor ramps to the new speed and direction */
+    Stepper_VelocitySet(jog_direction != 0, SPEED_LIMIT(speed), acceleration, deceleration, vbus_mv);
+    end_known = false;
+    return COMMAND_STATUS_OK;
+}
+
+static uint8_t ParamsSet(uint16_t acc, uint16_t dec, uint16_t speed, uint16_t jerk)
+{
+    if((acc == 0) || (dec == 0) || (speed == 0))
+        return COMMAND_STATUS_VALUE;
+
+    acceleration = acc;
+    deceleration = dec;
+    speed_limit = SPEED_LIMIT(speed);
+    Stepper_ProfileSet((jerk != 0) ? STEPPER_PROFILE_SCURVE : STEPPER_PROFILE_TRAPEZOID, jerk);
+    return COMMAND_STATUS_OK;
+}
+
+/* Executes the frame at the start of the receive buffer and answers it */
+static void Execute(uint8_t command, uint8_t length, uint16_t vbus_mv)
+{
+    uint8_t reply[6];
+    uint8_t reply_length = 1;
+    uint8_t status;
+    stepper_position_t position;
+
+    switch(command)
+    {
+        case COMMAND_MOVE:
+            status = (length == 4) ? MoveTo((stepper_position_t)PayloadU32(0), vbus_mv) : COMMAND_STATUS_LENGTH;
+            break;
+        case COMMAND_JOG:
+            status = (length == 3) ? Jog(PAYLOAD_U8(0), PayloadU16(1), vbus_mv) : COMMAND_STATUS_LENGTH;
+            break;
+        case COMMAND_STOP:
+            status = COMMAND_STATUS_LENGTH;
+            if(length == 0)
+            {
+                Stepper_Stop();
+                end_known = false;
+                status = COMMAND_STATUS_OK;
+            }
+            break;
+        case COMMAND_SET_PARAMS:
+            status = (length == 8) ? ParamsSet(PayloadU16(0), PayloadU16(2), PayloadU16(4), PayloadU16(6)) : COMMAND_STATUS_LENGTH;
+            break;
+        case COMMAND_QUERY_POSITION:
+            status = COMMAND_STATUS_LENGTH;
+            if(length == 0)
+            {
+                position = Stepper_GetPosition();
+                reply[1] = (uint8_t)position;
+                reply[2] = (uint8_t)(position >> 8);
+                reply[3] = (uint8_t)(position >> 16);
+                reply[4] = (uint8_t)(position >> 24);
+                reply[5] = Stepper_IsBusy();
+                reply_length = 6;
+                status = COMMAND_STATUS_OK;
+            }
+            break;
+        default:
+            status = COMMAND_STATUS_UNKNOWN;
+            break;
+    }
+    reply[0] = status;
+    if(status != COMMAND_STATUS_OK)
+        reply_length = 1;
+    ReplySend(command | COMMAND_REPLY, reply, reply_length);
+}
+
+void Command_Init(void)
+{
+    acceleration = DEGPS_TO_U16(0.3);
+    deceleration = DEGPS_TO_U16(0.3);
+    speed_limit = SPEED_LIMIT(DEGPS_TO_U16(180));
+    end_position = 0;
+    end_known = false;
+}
+
+void Command_Process(uint16_t vbus_mv)
+{
+    uint8_t count;
+
+    while((count = USART0_RxCountGet()) >= COMMAND_HEADER_SIZE)
+    {
+        uint8_t  length;
+        uint8_t  k;
+        uint16_t crc = 0xFFFF;
+
+        /* Bytes outside a frame are skipped up to the next SOF */
+        if(FRAME_U8(0) != COMMAND_SOF)
+        {
+            USART0_RxDiscard(1);
+            continue;
+        }
+        length = FRAME_U8(2);
+        if(length > COMMAND_PAYLOAD_MAX)
+        {
+            USART0_RxDiscard(1);
+            continue;
+        }
+        /* Wait for the rest of the frame */
+        if(count < COMMAND_HEADER_SIZE + length + COMMAND_CRC_SIZE)
+            return;
+
+        for(k = 1; k < COMMAND_HEADER_SIZE + length; k++)
+            crc = _crc_ccitt_update(crc, FRAME_U8(k));
+
+        if(crc != (uint16_t)(FRAME_U8(k) | ((uint16_t)FRAME_U8(k + 1) << 8)))
+        {
+            /* The SOF was a data byte or the frame is corrupted: resynchronize on the next SOF */
+            USART0_RxDiscard(1);
+            continue;
+        }
+
+        Execute(FRAME_U8(1), length, vbus_mv);
+        USART0_RxDiscard(COMMAND_HEADER_SIZE + length + COMMAND_CRC_SIZE);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* USER DEFINE CONFIGS*/
+#define COMMAND_INTERFACE       false           /* True: the drive is commanded over USART0. False: main.c runs the demo movements. */
+
+
+/* Frame format, all the multi-byte values are little-endian:
+ *   COMMAND_SOF | command | length | payload[length] | CRC LSB | CRC MSB
+ * The CRC is CRC-16/MCRF4XX (avr-libc _crc_ccitt_update, initial value 0xFFFF) over command, length and payload.
+ * Every valid frame is answered with a frame carrying (command | COMMAND_REPLY), the status as the first payload byte
+ * and the reply data after it. Frames with a wrong CRC or length are dropped without reply. */
+#define COMMAND_SOF             0xA5
+#define COMMAND_REPLY           0x80
+#define COMMAND_PAYLOAD_MAX     16
+
+
+/* Commands and payloads. Positions in sub-steps, speeds and rates in the units of Stepper_MoveStart. */
+#define COMMAND_MOVE            0x01            /* int32 target position */
+#define COMMAND_JOG             0x02            /* uint8 direction (0: CW, 1: CCW), uint16 speed. Runs until COMMAND_STOP or speed 0, can be sent again to change speed and direction. */
+#define COMMAND_STOP            0x03            /* No payload. Decelerates to standstill, the queued movements are dropped. */
+#define COMMAND_SET_PARAMS      0x04            /* uint16 acceleration, uint16 deceleration, uint16 speed, uint16 jerk (0: trapezoid) */
+#define COMMAND_QUERY_POSITION  0x05            /* No payload. Reply data: int32 position, uint8 busy */
+
+
+/* Reply status */
+#define COMMAND_STATUS_OK       0x00
+#define COMMAND_STATUS_UNKNOWN  0x01            /* Unknown command */
+#define COMMAND_STATUS_LENGTH   0x02            /* Wrong payload length for the command */
+#define COMMAND_STATUS_VALUE    0x03            /* Parameter out of range */
+#define COMMAND_STATUS_BUSY     0x04            /* Movement queue full, jog in progress, or target unknown while a stop is in progress */
+
+
+/* Function Prototypes*/
+void               Command_Init(void);
+
+/* Parses the complete frames waiting in the USART0 receive buffer and executes them. Called from the main loop.
+   vbus_mv: supply voltage passed to the movements started by the commands
+*/
+void               Command_Process(uint16_t);
+
+#endif /*  COMMAND_H  */
@@ -0,0 +1,65 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "encoder.h"
+
+
+#define ENCODER_A_PIN_bm                        (1 << ENCODER_A_PIN)
+#define ENCODER_B_PIN_bm                        (1 << ENCODER_B_PIN)
+
+/* Count change from the previous to the new A/B state, indexed by (previous << 2) | new, the state being (A << 1) | B.
+ * A jump of two states means an edge was missed, it is not counted. */
+static const int8_t quadrature_table[16] =
+{
+     0, -1, +1,  0,
+    +1,  0,  0, -1,
+    -1,  0,  0, +1,
+     0, +1, -1,  0
+};
+
+static uint8_t             state;
+static volatile uint16_t   count;
+
+static uint8_t StateRead(void)
+{
+    uint8_t in = ENCODER_PORT.IN;
+
+    return (uint8_t)(((in & ENCODER_A_PIN_bm) ? 2 : 0) | ((in & ENCODER_B_PIN_bm) ? 1 : 0));
+}
+
+void Encoder_Initialize(void)
+{
+    ENCODER_PORT.DIRCLR = ENCODER_A_PIN_bm | ENCODER_B_PIN_bm;
+    (&ENCODER_PORT.PIN0CTRL)[ENCODER_A_PIN] = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
+    (&ENCODER_PORT.PIN0CTRL)[ENCODER_B_PIN] = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        state = StateRead();
+        count = 0;
+    }
+}
+
+void Encoder_PinHandler(void)
+{
+    uint8_t new_state = StateRead();
+
+#if (ENCODER_REVERSE == true)
+    count -= quadrature_table[(state << 2) | new_state];
+#else
+    count += quadrature_table[(state << 2) | new_state];
+#endif
+    state = new_state;
+}
+
+uint16_t Encoder_CountGet(void)
+{
+    uint16_t value;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        value = count;
+    }
+    return value;
+}
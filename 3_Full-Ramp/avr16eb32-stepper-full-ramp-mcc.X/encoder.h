@@ -0,0 +1,33 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <avr/io.h>
+
+
+/* USER DEFINE CONFIGS*/
+#ifndef ENCODER_FEEDBACK                        /* Can be set on the compiler command line, as the host tests do */
+#define ENCODER_FEEDBACK        false           /* True: the tick compares the encoder with the position, see Stepper_FollowErrorGet */
+#endif
+#define ENCODER_COUNTS_PER_REV  4000            /* Quadrature counts per motor revolution: 4 per encoder line */
+#define ENCODER_REVERSE         false           /* True: the encoder counts down when the motor turns CW */
+#define CLOSED_LOOP             false           /* True: main.c closes the loop at startup, see Stepper_ClosedLoopSet. Needs ENCODER_FEEDBACK. */
+
+/* A and B inputs, decoded on both edges of both signals. Their pin interrupts must call Encoder_PinHandler, see main.c. */
+#define ENCODER_PORT            PORTC
+#define ENCODER_A_PIN           0
+#define ENCODER_B_PIN           3
+
+
+/* Function Prototypes*/
+void               Encoder_Initialize(void);
+
+/* Called from the interrupt of the A and B pins, see main.c */
+void               Encoder_PinHandler(void);
+
+/* Encoder position in counts, wrapping at 16 bits. The tick reads it once per period. */
+uint16_t           Encoder_CountGet(void);
+
+#endif /*  ENCODER_H  */
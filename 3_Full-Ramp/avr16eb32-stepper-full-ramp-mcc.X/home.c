@@ -0,0 +1,173 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "stepper.h"
+#include "home.h"
+
+
+#define HOME_PIN_bm                             (1 << HOME_PIN)
+#define HOME_PINCTRL                            ((&HOME_PORT.PIN0CTRL)[HOME_PIN])
+
+/* With an active low switch the input is inverted, so the pin always reads 1 and rises when the switch is active */
+#if (HOME_ACTIVE_LOW == true)
+#define HOME_PINCTRL_INIT                       (PORT_PULLUPEN_bm | PORT_INVEN_bm)
+#else
+#define HOME_PINCTRL_INIT                       0
+#endif
+
+#define HOME_SWITCH_ACTIVE()                    ((HOME_PORT.IN & HOME_PIN_bm) != 0)
+
+static volatile home_state_t state;
+
+/* Position at the switch edge, written by the pin interrupt */
+static stepper_position_t  latch;
+
+/* Standstill reported by the tick, taken by Home_Task */
+static volatile bool       idle_pending;
+static stepper_position_t  idle_position;
+
+/* Parameters of the sequence */
+static bool                home_direction;
+static uint16_t            seek_speed;
+static uint16_t            approach_speed;
+static uint16_t            acceleration;
+static uint16_t            deceleration;
+static uint16_t            vbus;
+
+static void SwitchDisable(void)
+{
+    HOME_PINCTRL = HOME_PINCTRL_INIT | PORT_ISC_INTDISABLE_gc;
+}
+
+/* Ends the sequence: the switch interrupt and the stepper idle callback are no longer needed */
+static void HomeEnd(home_state_t result)
+{
+    SwitchDisable();
+    Stepper_IdleCallbackRegister(NULL);
+    state = result;
+}
+
+/* Called from the tick each time the motor comes to standstill. The next movement is planned by Home_Task. */
+static void MotorIdle(stepper_position_t position)
+{
+    idle_position = position;
+    idle_pending = true;
+}
+
+/* Next step of the sequence, after the standstill at position */
+static void HomeNext(stepper_position_t position)
+{
+    switch(state)
+    {
+        case HOME_STATE_SEEK_STOP:
+            /* Back behind the edge, away from the switch */
+            state = HOME_STATE_BACKOFF;
+            Stepper_MoveStart((home_direction ? (latch + HOME_BACKOFF_STEPS) : (latch - HOME_BACKOFF_STEPS)) - position,
+                              acceleration, deceleration, seek_speed, vbus);
+            break;
+        case HOME_STATE_BACKOFF:
+            if(HOME_SWITCH_ACTIVE())
+            {
+                HomeEnd(HOME_STATE_FAILED);
+                break;
+            }
+            state = HOME_STATE_APPROACH;
+            Stepper_VelocitySet(home_direction, approach_speed, acceleration, deceleration, vbus);
+            break;
+        case HOME_STATE_APPROACH_STOP:
+            /* The switch edge becomes position 0, the motor stays where it has stopped */
+            Stepper_PositionSet(position - latch);
+            HomeEnd(HOME_STATE_DONE);
+            break;
+        case HOME_STATE_SEEK:
+        case HOME_STATE_APPROACH:
+            /* Stopped before reaching the switch */
+            HomeEnd(HOME_STATE_FAILED);
+            break;
+        default:
+            break;
+    }
+}
+
+void Home_SwitchHandler(void)
+{
+    /* The position only changes in the tick, so it is exact to the sub-step at the edge */
+    if(state == HOME_STATE_SEEK)
+    {
+        latch = Stepper_GetPosition();
+        state = HOME_STATE_SEEK_STOP;
+        Stepper_Stop();
+    }
+    else if(state == HOME_STATE_APPROACH)
+    {
+        latch = Stepper_GetPosition();
+        state = HOME_STATE_APPROACH_STOP;
+        Stepper_Stop();
+    }
+}
+
+bool Home_Start(bool direction, uint16_t seek, uint16_t approach, uint16_t acc, uint16_t dec, uint16_t vbus_mv)
+{
+    if(Stepper_IsBusy())
+        return false;
+
+    home_direction = direction;
+    seek_speed = seek;
+    approach_speed = approach;
+    acceleration = acc;
+    deceleration = dec;
+    vbus = vbus_mv;
+    idle_pending = false;
+    Stepper_IdleCallbackRegister(MotorIdle);
+
+    HOME_PORT.DIRCLR = HOME_PIN_bm;
+    HOME_PINCTRL = HOME_PINCTRL_INIT | PORT_ISC_RISING_gc;
+    HOME_PORT.INTFLAGS = HOME_PIN_bm;
+
+    if(HOME_SWITCH_ACTIVE())
+    {
+        /* Already on the switch: Home_Task starts with the back-off */
+        latch = Stepper_GetPosition();
+        state = HOME_STATE_SEEK_STOP;
+        MotorIdle(latch);
+        return true;
+    }
+
+    Stepper_VelocitySet(direction, seek, acc, dec, vbus_mv);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        /* The pin interrupt only latches in HOME_STATE_SEEK, an edge reached meanwhile is caught here */
+        if(HOME_SWITCH_ACTIVE())
+        {
+            latch = Stepper_GetPosition();
+            state = HOME_STATE_SEEK_STOP;
+            Stepper_Stop();
+        }
+        else
+        {
+            state = HOME_STATE_SEEK;
+        }
+    }
+    return true;
+}
+
+void Home_Task(void)
+{
+    stepper_position_t position;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(idle_pending == false)
+            return;
+        idle_pending = false;
+        position = idle_position;
+    }
+    HomeNext(position);
+}
+
+home_state_t Home_StateGet(void)
+{
+    return state;
+}
@@ -0,0 +1,53 @@
+#ifndef HOME_H
+#define HOME_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "stepper.h"
+
+
+/* USER DEFINE CONFIGS*/
+#define HOME_AT_STARTUP         false           /* True: main.c homes the motor before the demo movements or the command interface */
+#define HOME_PORT               PORTD           /* Port of the home switch */
+#define HOME_PIN                1               /* Pin of the home switch in HOME_PORT. Its interrupt must call Home_SwitchHandler, see main.c. */
+#define HOME_ACTIVE_LOW         true            /* True: the switch pulls the pin to ground, the internal pull-up is enabled */
+#define HOME_BACKOFF_STEPS      STEPS_TO_SUBSTEPS(8)    /* Distance from the switch edge to the start of the slow approach [sub-steps] */
+
+
+/* Homing sequence, followed by the switch interrupt and Home_Task */
+typedef enum
+{
+    HOME_STATE_IDLE = 0,
+    HOME_STATE_SEEK,                            /* Moving toward the switch with the seek speed */
+    HOME_STATE_SEEK_STOP,                       /* Edge latched, decelerating */
+    HOME_STATE_BACKOFF,                         /* Moving back behind the latched edge */
+    HOME_STATE_APPROACH,                        /* Moving toward the switch with the approach speed */
+    HOME_STATE_APPROACH_STOP,                   /* Edge latched, decelerating */
+    HOME_STATE_DONE,                            /* Position 0 is the switch edge */
+    HOME_STATE_FAILED                           /* Stopped before the edge, or the switch is still active after the back-off */
+} home_state_t;
+
+
+/* Function Prototypes*/
+/* Starts the homing sequence: the motor runs toward the switch, the switch edge stops it, it backs off by
+   HOME_BACKOFF_STEPS and comes back with the approach speed. The position latched at the second edge becomes 0.
+   The switch interrupt and the stepper idle callback only record the events, the main loop calls Home_Task until
+   HOME_STATE_DONE or HOME_STATE_FAILED. Registers the stepper idle callback and unregisters it at the end. Stepper_Stop, Stepper_QuickStop or
+   Stepper_Abort cancel it.
+   params:
+    direction: direction of the switch, as in Stepper_VelocitySet (true: CCW)
+    seek_speed, approach_speed, acceleration, deceleration, vbus: in the units of Stepper_MoveStart
+   returns: false if the motor is busy
+*/
+bool               Home_Start(bool, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t);
+home_state_t       Home_StateGet(void);
+
+/* Called from the main loop during the sequence. Starts the next phase once the motor has stopped, so the
+   movement planning runs outside the tick. */
+void               Home_Task(void);
+
+/* Called from the interrupt of the home switch pin. Latches the position at the activating edge. */
+void               Home_SwitchHandler(void);
+
+#endif /*  HOME_H  */
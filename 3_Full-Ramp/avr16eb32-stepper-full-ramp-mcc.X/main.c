@@ -31,19 +31,51 @@
     THIS SOFTWARE.
 */
 #include <stdio.h>
+#include <util/atomic.h>
 #include "mcc_generated_files/system/system.h"
 #include "util/delay.h"
 #include "stepper.h"
+#include "command.h"
+#include "home.h"
+#include "step_dir.h"
+#include "encoder.h"
 
-/*  Function that returns the voltage expressed in mV */
-uint16_t Get_VBus(adc_0_channel_t channel)
+/* Latest supply voltage in mV, updated by the ADC0 free-running conversions */
+static volatile uint16_t vbus_mv;
+
+/* Called from the ADC0 interrupt for every accumulated result. The stepper amplitude follows the supply voltage.
+ * In Burst Scaling mode the sum of the samples is scaled back to the 16-bit left adjusted range,
+ * so the same conversion to mV applies for any number of accumulated samples. */
+void VBus_ResultReady(void)
+{
+    uint16_t new_vbus_mv = (uint16_t)(((uint32_t)ADC0_GetConversionResult() * VBUS_MV_SCALE) >> 16);
+
+    vbus_mv = new_vbus_mv;
+    Stepper_VBusSet(new_vbus_mv);
+}
+
+/* Starts the free-running conversions of the VBUS input. Every result is the average of VBUS_SAMPNUM samples
+ * accumulated in hardware, so the interrupt and the conversion to mV run once per burst. */
+void VBus_Start(adc_0_channel_t channel)
 {
-    uint16_t vbus_mv;
+    ADC0_ResultReadyCallbackRegister(VBus_ResultReady);
+    ADC0_StopConversion();
+    ADC0.CTRLF = (ADC0.CTRLF & ~ADC_SAMPNUM_gm) | VBUS_SAMPNUM;
+    ADC0.COMMAND = ADC_MODE_BURST_SCALING_gc;
+    ADC0.INTCTRL |= ADC_RESRDY_bm;
     ADC0_StartConversion(channel);
-    while(ADC0_IsConversionDone() == 0);
-    _delay_us(50);
-    vbus_mv = (uint16_t)(K_VBUS * ADC_VREF * (float)ADC0_GetConversionResult() / 65.536);   
-    return vbus_mv;
+}
+
+/*  Function that returns the voltage expressed in mV. Only reads the last result. */
+uint16_t Get_VBus(void)
+{
+    uint16_t vbus;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        vbus = vbus_mv;
+    }
+    return vbus;
 }
 
 stepper_position_t MainMove(stepper_position_t position, stepper_position_t displacement, uint16_t speed)
@@ -52,20 +84,49 @@ stepper_position_t MainMove(stepper_position_t position, stepper_position_t disp
     uint16_t decc  = DEGPS_TO_U16(0.3);
     uint16_t vbus;
 
-    vbus = Get_VBus(VBUS_ADC);
+    vbus = Get_VBus();
+    /* The movement starts from position at standstill, as with Stepper_Move. It is started first, the log below is
+     * sent by the USART0 interrupt while the motor runs. */
+    if(Stepper_IsBusy())
+    {
+        printf("\n\rMovement refused, the motor is busy\n\r");
+        return Stepper_GetPosition();
+    }
+    Stepper_PositionSet(position);
+    if(Stepper_MoveStart(displacement, acc, decc, speed, vbus) == false)
+    {
+        printf("\n\rMovement refused\n\r");
+        return position;
+    }
     printf("\n\rSupply voltage: \t%.2f V", 0.001*(float)vbus);
     printf("\n\rInitial position:\t%.2f steps / %ld sub-steps", SUBSTEPS_TO_STEPS(position), position);
     printf("\n\rMoving with speed:\t%.3f degrees/second", U16_TO_DEGPS(speed));
-    position = Stepper_Move(position, displacement, acc, decc, speed, vbus);
+    while(Stepper_IsBusy())
+    {
+        /* The movement runs from the TCE0 interrupt; the main loop is free here */
+    }
+    position = Stepper_GetPosition();
     printf("\n\rFinal position: \t%.2f steps / %ld sub-steps", SUBSTEPS_TO_STEPS(position), position);
+#if (ENCODER_FEEDBACK == true)
+    printf("\n\rFollowing error:\t%ld sub-steps%s", Stepper_FollowErrorGet(), Stepper_FollowErrorFlagGet() ? ", steps missed" : "");
+#endif /* ENCODER_FEEDBACK */
+    printf("\n\rLongest tick:   \t%u of %u clocks", Stepper_TickClocksMaxGet(), TICK_CLOCKS);
+    if(USART0_TxDroppedGet() != 0)
+        printf("\n\rLog bytes dropped:\t%u", USART0_TxDroppedGet());
     printf("\n\r");
     return position;
 }
 
-int main(void)
+#if (ENCODER_FEEDBACK == true)
+/* Called from the tick when the encoder is more than FOLLOW_ERROR_LIMIT away from the position: the motor has missed steps */
+static void FollowErrorStop(stepper_position_t position)
 {
-    stepper_position_t stepper_position = 0;
+    Stepper_QuickStop();
+}
+#endif /* ENCODER_FEEDBACK */
 
+int main(void)
+{
     /* System initialize */
     SYSTEM_Initialize();
 
@@ -73,7 +134,59 @@ int main(void)
     TCE0_OverflowCallbackRegister(Stepper_TimeTick);
 
     Stepper_Init();
-    
+
+    /* The supply voltage is tracked in the background, also during the movements */
+    VBus_Start(VBUS_ADC);
+
+    /* The home switch pin (HOME_PORT, HOME_PIN) interrupt is dispatched by the pin manager */
+    IO_PD1_SetInterruptHandler(Home_SwitchHandler);
+
+#if (ENCODER_FEEDBACK == true)
+    /* The encoder A and B pin interrupts (ENCODER_PORT) are dispatched by the pin manager */
+    IO_PC0_SetInterruptHandler(Encoder_PinHandler);
+    IO_PC3_SetInterruptHandler(Encoder_PinHandler);
+    Encoder_Initialize();
+    Stepper_FollowErrorReset();
+    Stepper_FollowErrorCallbackRegister(FollowErrorStop);
+#if (CLOSED_LOOP == true)
+    /* Aligns the encoder on the held position and closes the loop */
+    Stepper_ClosedLoopSet(true);
+    while(Stepper_IsBusy())
+    {
+    }
+#endif /* CLOSED_LOOP */
+#endif /* ENCODER_FEEDBACK */
+
+#if (HOME_AT_STARTUP == true)
+    /* Runs toward the switch in CCW direction and makes its edge position 0 */
+    Home_Start(true, SPEED_LIMIT(DEGPS_TO_U16(90)), SPEED_LIMIT(DEGPS_TO_U16(9)), DEGPS_TO_U16(0.3), DEGPS_TO_U16(0.3), Get_VBus());
+    while((Home_StateGet() != HOME_STATE_DONE) && (Home_StateGet() != HOME_STATE_FAILED))
+    {
+        Home_Task();
+    }
+    printf("\n\rHoming %s, position: %ld sub-steps", (Home_StateGet() == HOME_STATE_DONE) ? "done" : "failed", Stepper_GetPosition());
+#endif /* HOME_AT_STARTUP */
+
+#if (STEP_DIR_INTERFACE == true)
+    /* The motor follows the STEP/DIR inputs from the TCE0 interrupt, the pulses are counted by TCB0 and the DIR pin
+     * (DIR_PORT, DIR_PIN_bm) interrupt is dispatched by the pin manager */
+    IO_PD4_SetInterruptHandler(StepDir_DirectionHandler);
+    StepDir_Initialize();
+    Stepper_StepDirStart(STEP_DIR_RATIO, Get_VBus());
+    while(1)
+    {
+    }
+#elif (COMMAND_INTERFACE == true)
+    /* The movements are commanded over USART0, see command.h for the frame format.
+     * The frames are parsed here while the movements run from the TCE0 interrupt. */
+    Command_Init();
+    while(1)
+    {
+        Command_Process(Get_VBus());
+    }
+#else
+    stepper_position_t stepper_position = 0;
+
     _delay_ms(2000);
     printf("\n\r-----------------------------------------------");
     printf("\n\rStepping Mode: %s, 1 step = %d sub-steps", STRING, K_MODE);
@@ -100,5 +213,6 @@ int main(void)
                                     speed);
         _delay_ms(500);
     }
+#endif /* STEP_DIR_INTERFACE, COMMAND_INTERFACE */
 }
 
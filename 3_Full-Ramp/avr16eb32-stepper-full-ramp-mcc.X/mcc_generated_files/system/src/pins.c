@@ -45,6 +45,10 @@ static void (*IO_PA7_InterruptHandler)(void);
 static void (*IO_PF4_InterruptHandler)(void);
 static void (*IO_PC2_InterruptHandler)(void);
 static void (*IO_PC1_InterruptHandler)(void);
+static void (*IO_PD1_InterruptHandler)(void);
+static void (*IO_PD4_InterruptHandler)(void);
+static void (*IO_PC0_InterruptHandler)(void);
+static void (*IO_PC3_InterruptHandler)(void);
 
 void PIN_MANAGER_Initialize()
 {
@@ -122,6 +126,10 @@ void PIN_MANAGER_Initialize()
     IO_PF4_SetInterruptHandler(IO_PF4_DefaultInterruptHandler);
     IO_PC2_SetInterruptHandler(IO_PC2_DefaultInterruptHandler);
     IO_PC1_SetInterruptHandler(IO_PC1_DefaultInterruptHandler);
+    IO_PD1_SetInterruptHandler(IO_PD1_DefaultInterruptHandler);
+    IO_PD4_SetInterruptHandler(IO_PD4_DefaultInterruptHandler);
+    IO_PC0_SetInterruptHandler(IO_PC0_DefaultInterruptHandler);
+    IO_PC3_SetInterruptHandler(IO_PC3_DefaultInterruptHandler);
 }
 
 /**
@@ -267,6 +275,58 @@ void IO_PC1_DefaultInterruptHandler(void)
     // add your IO_PC1 interrupt custom code
     // or set custom function using IO_PC1_SetInterruptHandler()
 }
+/**
+  Allows selecting an interrupt handler for IO_PD1 at application runtime
+*/
+void IO_PD1_SetInterruptHandler(void (* interruptHandler)(void)) 
+{
+    IO_PD1_InterruptHandler = interruptHandler;
+}
+
+void IO_PD1_DefaultInterruptHandler(void)
+{
+    // add your IO_PD1 interrupt custom code
+    // or set custom function using IO_PD1_SetInterruptHandler()
+}
+/**
+  Allows selecting an interrupt handler for IO_PD4 at application runtime
+*/
+void IO_PD4_SetInterruptHandler(void (* interruptHandler)(void)) 
+{
+    IO_PD4_InterruptHandler = interruptHandler;
+}
+
+void IO_PD4_DefaultInterruptHandler(void)
+{
+    // add your IO_PD4 interrupt custom code
+    // or set custom function using IO_PD4_SetInterruptHandler()
+}
+/**
+  Allows selecting an interrupt handler for IO_PC0 at application runtime
+*/
+void IO_PC0_SetInterruptHandler(void (* interruptHandler)(void)) 
+{
+    IO_PC0_InterruptHandler = interruptHandler;
+}
+
+void IO_PC0_DefaultInterruptHandler(void)
+{
+    // add your IO_PC0 interrupt custom code
+    // or set custom function using IO_PC0_SetInterruptHandler()
+}
+/**
+  Allows selecting an interrupt handler for IO_PC3 at application runtime
+*/
+void IO_PC3_SetInterruptHandler(void (* interruptHandler)(void)) 
+{
+    IO_PC3_InterruptHandler = interruptHandler;
+}
+
+void IO_PC3_DefaultInterruptHandler(void)
+{
+    // add your IO_PC3 interrupt custom code
+    // or set custom function using IO_PC3_SetInterruptHandler()
+}
 ISR(PORTA_PORT_vect)
 { 
     // Call the interrupt handler for the callback registered at runtime
@@ -308,23 +368,44 @@ ISR(PORTA_PORT_vect)
 
 ISR(PORTC_PORT_vect)
 { 
+    /* The flags are cleared before the handlers, so an encoder edge during the handlers raises the interrupt again */
+    uint8_t flags = VPORTC.INTFLAGS;
+    VPORTC.INTFLAGS = flags;
+
     // Call the interrupt handler for the callback registered at runtime
-    if(VPORTC.INTFLAGS & PORT_INT2_bm)
+    if(flags & PORT_INT2_bm)
     {
        IO_PC2_InterruptHandler(); 
     }
-    if(VPORTC.INTFLAGS & PORT_INT1_bm)
+    if(flags & PORT_INT1_bm)
     {
        IO_PC1_InterruptHandler(); 
     }
-    /* Clear interrupt flags */
-    VPORTC.INTFLAGS = 0xff;
+    if(flags & PORT_INT0_bm)
+    {
+       IO_PC0_InterruptHandler(); 
+    }
+    if(flags & PORT_INT3_bm)
+    {
+       IO_PC3_InterruptHandler(); 
+    }
 }
 
 ISR(PORTD_PORT_vect)
 { 
-    /* Clear interrupt flags */
-    VPORTD.INTFLAGS = 0xff;
+    /* Clear the interrupt flags taken, before the handlers read the pins: an edge during the handlers interrupts again */
+    uint8_t flags = VPORTD.INTFLAGS;
+
+    VPORTD.INTFLAGS = flags;
+    // Call the interrupt handler for the callback registered at runtime
+    if(flags & PORT_INT1_bm)
+    {
+       IO_PD1_InterruptHandler(); 
+    }
+    if(flags & PORT_INT4_bm)
+    {
+       IO_PD4_InterruptHandler(); 
+    }
 }
 
 ISR(PORTF_PORT_vect)
@@ -41,6 +41,8 @@
   Section: Macro Declarations
 */
 
+#define USART0_TX_BUFFER_MASK (USART0_TX_BUFFER_SIZE - 1U)
+#define USART0_RX_BUFFER_MASK (USART0_RX_BUFFER_SIZE - 1U)
 
 
 /**
@@ -79,6 +81,18 @@ const uart_drv_interface_t UART0 = {
 */
 static volatile usart0_status_t usart0RxLastError;
 
+/* Transmit ring buffer, filled by USART0_Write and drained by the Data Register Empty interrupt */
+static volatile uint8_t usart0TxHead = 0;
+static volatile uint8_t usart0TxTail = 0;
+static volatile uint8_t usart0TxBuffer[USART0_TX_BUFFER_SIZE];
+static volatile uint16_t usart0TxBufferRemaining;
+static volatile uint16_t usart0TxDropped;
+
+/* Receive ring buffer, filled by the Receive Complete interrupt. The head is written only by the interrupt, the tail only by the readers. */
+static volatile uint8_t usart0RxHead = 0;
+static volatile uint8_t usart0RxTail = 0;
+static volatile uint8_t usart0RxBuffer[USART0_RX_BUFFER_SIZE];
+
 /**
   Section: USART0 APIs
 */
@@ -100,7 +114,6 @@ static void USART0_DefaultParityErrorCallback(void);
 
 int USART0_printCHAR(char character, FILE *stream)
 {
-    while(!(USART0_IsTxReady()));
     USART0_Write(character);
     return 0;
 }
@@ -111,7 +124,6 @@ FILE USART0_stream = FDEV_SETUP_STREAM(USART0_printCHAR, NULL, _FDEV_SETUP_WRITE
 
 int putchar (int outChar)
 {
-    while(!(USART0_IsTxReady()));
     USART0_Write(outChar);
     return outChar;
 }
@@ -124,8 +136,9 @@ void USART0_Initialize(void)
     //BAUD 694; 
     USART0.BAUD = (uint16_t)USART0_BAUD_RATE(115200);
 	
-    // ABEIE disabled; DREIE disabled; LBME disabled; RS485 DISABLE; RXCIE disabled; RXSIE disabled; TXCIE disabled; 
-    USART0.CTRLA = 0x0;
+    // ABEIE disabled; DREIE disabled; LBME disabled; RS485 DISABLE; RXCIE enabled; RXSIE disabled; TXCIE disabled; 
+    // DREIE is enabled by USART0_Write while the transmit buffer holds data
+    USART0.CTRLA = 0x80;
 	
     // MPCM disabled; ODME disabled; RXEN enabled; RXMODE NORMAL; SFDEN disabled; TXEN enabled; 
     USART0.CTRLB = 0xC0;
@@ -149,6 +162,12 @@ void USART0_Initialize(void)
     USART0_OverrunErrorCallbackRegister(USART0_DefaultOverrunErrorCallback);
     USART0_ParityErrorCallbackRegister(USART0_DefaultParityErrorCallback);
     usart0RxLastError.status = 0;  
+    usart0TxHead = 0;
+    usart0TxTail = 0;
+    usart0TxBufferRemaining = USART0_TX_BUFFER_SIZE;
+    usart0TxDropped = 0;
+    usart0RxHead = 0;
+    usart0RxTail = 0;
 #if defined(__GNUC__)
     stdout = &USART0_stream;
 #endif
@@ -235,59 +254,159 @@ void USART0_AutoBaudDetectErrorReset(void)
 
 bool USART0_IsRxReady(void)
 {
-    return (bool)(USART0.STATUS & USART_RXCIF_bm);
+    return (usart0RxHead != usart0RxTail);
+}
+
+uint8_t USART0_RxCountGet(void)
+{
+    return (usart0RxHead - usart0RxTail) & USART0_RX_BUFFER_MASK;
+}
+
+uint8_t USART0_RxPeek(uint8_t offset)
+{
+    return usart0RxBuffer[(usart0RxTail + offset) & USART0_RX_BUFFER_MASK];
+}
+
+void USART0_RxDiscard(uint8_t count)
+{
+    uint8_t available = USART0_RxCountGet();
+
+    if(count > available)
+    {
+        count = available;
+    }
+    usart0RxTail = (usart0RxTail + count) & USART0_RX_BUFFER_MASK;
 }
 
 bool USART0_IsTxReady(void)
 {
-    return (bool)(USART0.STATUS & USART_DREIF_bm);
+    return (usart0TxBufferRemaining != 0U);
 }
 
 bool USART0_IsTxDone(void)
 {
-    return (bool)(USART0.STATUS & USART_TXCIF_bm);
+    return (usart0TxBufferRemaining == USART0_TX_BUFFER_SIZE) && (bool)(USART0.STATUS & USART_TXCIF_bm);
+}
+
+uint16_t USART0_TxDroppedGet(void)
+{
+    return usart0TxDropped;
 }
 
 size_t USART0_ErrorGet(void)
 {
+    size_t status;
+
+    // The errors are collected by the receive interrupt
+    USART0.CTRLA &= ~(USART_RXCIE_bm);
+    status = usart0RxLastError.status;
     usart0RxLastError.status = 0;
-    
-    if(USART0.RXDATAH & USART_FERR_bm)
+    USART0.CTRLA |= USART_RXCIE_bm;
+    return status;
+}
+
+uint8_t USART0_Read(void)
+{
+    uint8_t readValue = usart0RxBuffer[usart0RxTail];
+
+    usart0RxTail = (usart0RxTail + 1U) & USART0_RX_BUFFER_MASK;
+    return readValue;
+}
+
+
+void USART0_Write(uint8_t txData)
+{
+    if(0U == usart0TxBufferRemaining)
+    {
+#if (USART0_TX_OVERFLOW_POLICY == USART0_TX_OVERFLOW_BLOCK)
+        while(0U == usart0TxBufferRemaining)
+        {
+            // With the interrupts disabled the buffer is drained here
+            if(((SREG & CPU_I_bm) == 0U) && (USART0.STATUS & USART_DREIF_bm))
+            {
+                USART0_TransmitISR();
+            }
+        }
+#else
+        if(usart0TxDropped != UINT16_MAX)
+        {
+            usart0TxDropped++;
+        }
+        return;
+#endif
+    }
+
+    usart0TxBuffer[usart0TxHead] = txData;
+    usart0TxHead = (usart0TxHead + 1U) & USART0_TX_BUFFER_MASK;
+
+    // The interrupt is disabled while the shared counter is updated
+    USART0.CTRLA &= ~(USART_DREIE_bm);
+    usart0TxBufferRemaining--;
+    USART0.CTRLA |= USART_DREIE_bm;
+}
+
+void USART0_TransmitISR(void)
+{
+    if(USART0_TX_BUFFER_SIZE != usart0TxBufferRemaining)
+    {
+        USART0.TXDATAL = usart0TxBuffer[usart0TxTail];
+        usart0TxTail = (usart0TxTail + 1U) & USART0_TX_BUFFER_MASK;
+        usart0TxBufferRemaining++;
+    }
+    else
+    {
+        // Nothing left to send
+        USART0.CTRLA &= ~(USART_DREIE_bm);
+    }
+}
+
+void USART0_ReceiveISR(void)
+{
+    // The error flags belong to the byte in RXDATAL, so RXDATAH is read first
+    uint8_t rxStatus = USART0.RXDATAH;
+    uint8_t rxData = USART0.RXDATAL;
+    uint8_t nextHead = (usart0RxHead + 1U) & USART0_RX_BUFFER_MASK;
+
+    if(rxStatus & USART_FERR_bm)
     {
         usart0RxLastError.ferr = 1;
         if(NULL != USART0_FramingErrorHandler)
         {
             USART0_FramingErrorHandler();
-        }  
+        }
     }
-    if(USART0.RXDATAH & USART_PERR_bm)
+    if(rxStatus & USART_PERR_bm)
     {
         usart0RxLastError.perr = 1;
         if(NULL != USART0_ParityErrorHandler)
         {
             USART0_ParityErrorHandler();
-        }  
+        }
     }
-    if(USART0.RXDATAH & USART_BUFOVF_bm)
+    if((rxStatus & USART_BUFOVF_bm) || (nextHead == usart0RxTail))
     {
         usart0RxLastError.oerr = 1;
         if(NULL != USART0_OverrunErrorHandler)
         {
             USART0_OverrunErrorHandler();
-        }   
+        }
+    }
+
+    if(nextHead != usart0RxTail)
+    {
+        usart0RxBuffer[usart0RxHead] = rxData;
+        usart0RxHead = nextHead;
     }
-    return usart0RxLastError.status;
 }
 
-uint8_t USART0_Read(void)
+ISR(USART0_DRE_vect)
 {
-    return USART0.RXDATAL;
+    USART0_TransmitISR();
 }
 
-
-void USART0_Write(uint8_t txData)
+ISR(USART0_RXC_vect)
 {
-    USART0.TXDATAL = txData;    // Write the data byte to the USART.
+    USART0_ReceiveISR();
 }
 static void USART0_DefaultFramingErrorCallback(void)
 {
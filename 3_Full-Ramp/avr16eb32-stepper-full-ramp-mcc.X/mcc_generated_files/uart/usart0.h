@@ -52,6 +52,17 @@
 /* Normal Mode, Baud register value */
 #define USART0_BAUD_RATE(BAUD_RATE) (((float)20000000 * 64 / (16 * (float)BAUD_RATE)) + 0.5)
 
+/* Transmit buffer size in bytes, power of two up to 256 */
+#define USART0_TX_BUFFER_SIZE (256U)
+
+/* Behavior of USART0_Write when the transmit buffer is full */
+#define USART0_TX_OVERFLOW_DROP     0   /* The byte is discarded and counted, the caller never waits */
+#define USART0_TX_OVERFLOW_BLOCK    1   /* The caller waits until the buffer has space */
+#define USART0_TX_OVERFLOW_POLICY   USART0_TX_OVERFLOW_DROP
+
+/* Receive buffer size in bytes, power of two up to 256. One byte is kept free to tell a full buffer from an empty one. */
+#define USART0_RX_BUFFER_SIZE (64U)
+
 #define UART0_interface UART0
 
 
@@ -220,17 +231,42 @@ void USART0_AutoBaudDetectErrorReset(void);
  * @ingroup usart0
  * @brief This API checks if USART0 receiver has received data and ready to be read.
  * @param None.
- * @retval true if USART0 receiver FIFO has a data
- * @retval false USART0 receiver FIFO is empty
+ * @retval true if USART0 receive buffer has a data
+ * @retval false USART0 receive buffer is empty
  */
 bool USART0_IsRxReady(void);
 
+/**
+ * @ingroup usart0
+ * @brief This function returns the number of bytes waiting in the receive buffer.
+ * @param None.
+ * @return Number of received bytes not read yet.
+ */
+uint8_t USART0_RxCountGet(void);
+
+/**
+ * @ingroup usart0
+ * @brief This function returns a received byte without removing it from the receive buffer.
+ * @pre offset must be lower than USART0_RxCountGet().
+ * @param offset - Position of the byte, 0 being the oldest byte in the buffer.
+ * @return The received byte.
+ */
+uint8_t USART0_RxPeek(uint8_t offset);
+
+/**
+ * @ingroup usart0
+ * @brief This function removes the oldest bytes from the receive buffer.
+ * @param count - Number of bytes to remove, limited to USART0_RxCountGet().
+ * @return None.
+ */
+void USART0_RxDiscard(uint8_t count);
+
 /**
  * @ingroup usart0
  * @brief This function checks if USART0 transmitter is ready to accept a data byte.
  * @param None.
- * @retval true if USART0 transmitter FIFO has atleast 1 byte space
- * @retval false if USART0 transmitter FIFO is full
+ * @retval true if USART0 transmit buffer has atleast 1 byte space
+ * @retval false if USART0 transmit buffer is full
  */
 bool USART0_IsTxReady(void);
 
@@ -245,33 +281,58 @@ bool USART0_IsTxDone(void);
 
 /**
  * @ingroup usart0
- * @brief This function gets the error status of the last read byte.
- *        This function should be called before USART0_Read().
+ * @brief This function gets the errors of the bytes received since the previous call and clears them.
+ *        The overrun error is also set when a byte is lost because the receive buffer is full.
  * @param None.
- * @return Status of the last read byte. See usart0_status_t struct for more details.
+ * @return Status of the received bytes. See usart0_status_t struct for more details.
  */
 size_t USART0_ErrorGet(void);
 
 /**
  * @ingroup usart0
- * @brief This function reads the 8 bits from receiver FIFO register.
+ * @brief This function reads the oldest byte from the receive buffer.
  * @pre The transfer status should be checked to see if the receiver is not empty
  *      before calling this function. USART0_IsRxReady() should be checked in if () before calling this API.
  * @param None.
- * @return 8-bit data from RX FIFO register.
+ * @return 8-bit data from the receive buffer.
  */
 uint8_t USART0_Read(void);
 
 /**
  * @ingroup usart0
- * @brief This function writes a byte of data to the transmitter FIFO register.
- * @pre The transfer status should be checked to see if the transmitter is ready to accept a byte
- *      before calling this function. USART0_IsTxReady() should be checked in if() before calling this API.
- * @param txData  - Data byte to write to the TX FIFO.
+ * @brief This function writes a byte of data to the transmit buffer. The byte is sent by the
+ *        Data Register Empty interrupt. If the buffer is full, the byte is dropped or the function waits,
+ *        depending on USART0_TX_OVERFLOW_POLICY.
+ * @param txData  - Data byte to write to the transmit buffer.
  * @return None.
  */
 void USART0_Write(uint8_t txData);
 
+/**
+ * @ingroup usart0
+ * @brief This function sends the next byte of the transmit buffer. Called from the Data Register Empty interrupt.
+ * @param None.
+ * @return None.
+ */
+void USART0_TransmitISR(void);
+
+/**
+ * @ingroup usart0
+ * @brief This function stores the received byte in the receive buffer. Called from the Receive Complete interrupt.
+ * @param None.
+ * @return None.
+ */
+void USART0_ReceiveISR(void);
+
+/**
+ * @ingroup usart0
+ * @brief This function returns the number of bytes dropped because the transmit buffer was full.
+ *        The count saturates at UINT16_MAX.
+ * @param None.
+ * @return Number of dropped bytes since initialization.
+ */
+uint16_t USART0_TxDroppedGet(void);
+
 /**
  * @ingroup usart0
  * @brief This API registers the function to be called upon USART0 framing error.
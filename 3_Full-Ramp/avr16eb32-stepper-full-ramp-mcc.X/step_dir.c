@@ -0,0 +1,66 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "step_dir.h"
+
+
+/* Pulses before the DIR edges not yet read by the tick, signed, and the hardware count and the direction since the
+ * last edge */
+static volatile int16_t    reversed_steps;
+static volatile uint16_t   direction_count;
+static volatile bool       direction_ccw;
+
+void StepDir_Initialize(void)
+{
+    STEP_PORT.DIRCLR = STEP_PIN_bm;
+    DIR_PORT.DIRCLR = DIR_PIN_bm;
+
+    /* STEP pin -> port event generator 0 -> event channel -> TCB0 count input */
+    STEP_PORT.EVGENCTRLA = (STEP_PORT.EVGENCTRLA & ~PORT_EVGEN0SEL_gm) | STEP_PIN_EVGEN;
+    STEP_EVSYS_CHANNEL = STEP_EVSYS_GENERATOR;
+    EVSYS.USERTCB0COUNT = STEP_EVSYS_USER;
+
+    /* TCB0 clocked by the events: a free-running 16-bit counter of the rising edges, without interrupt */
+    TCB0.CTRLA = 0;
+    TCB0.CTRLB = TCB_CNTMODE_INT_gc;
+    TCB0.CCMP = 0xFFFF;
+    TCB0.CNT = 0;
+    TCB0.INTCTRL = 0;
+    TCB0.CTRLA = TCB_CLKSEL_EVENT_gc | TCB_ENABLE_bm;
+
+    /* DIR edges latch the count, at the high priority level as the tick may run for tens of microseconds */
+    reversed_steps = 0;
+    direction_count = 0;
+    direction_ccw = (DIR_PORT.IN & DIR_PIN_bm) != 0;
+    CPUINT.LVL1VEC = DIR_PORT_vect_num;
+    DIR_PINCTRL = (DIR_PINCTRL & ~PORT_ISC_gm) | PORT_ISC_BOTHEDGES_gc;
+}
+
+int16_t StepDir_StepsGet(void)
+{
+    uint16_t count;
+    uint16_t pulses;
+    int16_t  steps;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        count = TCB0.CNT;
+        pulses = count - direction_count;
+        steps = reversed_steps + (direction_ccw ? -(int16_t)pulses : (int16_t)pulses);
+        direction_count = count;
+        reversed_steps = 0;
+    }
+    return steps;
+}
+
+void StepDir_DirectionHandler(void)
+{
+    uint16_t count = TCB0.CNT;
+    uint16_t pulses = count - direction_count;
+
+    /* The pulses until this edge were sent in the previous direction */
+    reversed_steps += direction_ccw ? -(int16_t)pulses : (int16_t)pulses;
+    direction_count = count;
+    direction_ccw = (DIR_PORT.IN & DIR_PIN_bm) != 0;
+}
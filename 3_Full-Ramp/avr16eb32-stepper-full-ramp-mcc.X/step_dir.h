@@ -0,0 +1,50 @@
+#ifndef STEP_DIR_H
+#define STEP_DIR_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <avr/io.h>
+
+
+/* USER DEFINE CONFIGS*/
+#define STEP_DIR_INTERFACE      false           /* True: the motor follows the STEP/DIR inputs, see main.c */
+#define STEP_DIR_RATIO          1               /* Sub-steps moved for every STEP pulse, 1 ... 255 */
+
+/* Interpolation of coarse pulses, for example full-steps with STEP_DIR_RATIO = K_MODE: each pulse is spread over
+ * the measured pulse period in sub-steps, so the motor moves smoothly, one pulse behind the input */
+#ifndef STEP_DIR_INTERPOLATE                    /* Can be set on the compiler command line, as the host tests do */
+#define STEP_DIR_INTERPOLATE    false
+#endif
+#define STEP_DIR_PERIOD_MAX     200             /* Longest pulse period used for the interpolation [ticks], a single pulse ends within it */
+
+/* STEP input: counted on its rising edges by TCB0, through the port event generator 0 and an event channel */
+#define STEP_PORT               PORTD
+#define STEP_PIN_EVGEN          PORT_EVGEN0SEL_PIN3_gc
+#define STEP_PIN_bm             PIN3_bm
+#define STEP_EVSYS_CHANNEL      EVSYS.CHANNEL2
+#define STEP_EVSYS_GENERATOR    EVSYS_CHANNEL_PORTD_EVGEN0_gc
+#define STEP_EVSYS_USER         EVSYS_USER_CHANNEL2_gc
+
+/* DIR input: low for CW, high for CCW, as the direction of Stepper_VelocitySet. Its interrupt on both edges must
+ * call StepDir_DirectionHandler, see main.c. It shares the PORTD vector with the home switch, which is raised to the
+ * high priority level so that the tick does not delay it: homing must be done before StepDir_Initialize. */
+#define DIR_PORT                PORTD
+#define DIR_PIN_bm              PIN4_bm
+#define DIR_PINCTRL             PORTD.PIN4CTRL
+#define DIR_PORT_vect_num       PORTD_PORT_vect_num
+
+
+/* Function Prototypes*/
+void               StepDir_Initialize(void);
+
+/* STEP pulses since the previous call, positive for CW. The pulses counted by the hardware up to each DIR edge are
+   taken with the direction before it, so a reversal within a tick is followed exactly as long as the DIR setup time
+   of the controller, from the DIR edge to the next STEP edge, covers the interrupt response of about 1 us.
+   The tick reads it once per period, no pulse is lost as long as fewer than 32768 arrive in a tick. */
+int16_t            StepDir_StepsGet(void);
+
+/* DIR pin interrupt handler, on both edges */
+void               StepDir_DirectionHandler(void);
+
+#endif /*  STEP_DIR_H  */
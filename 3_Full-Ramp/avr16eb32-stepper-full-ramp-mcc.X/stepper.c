@@ -1,352 +1,2053 @@
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <util/atomic.h>
 #include "mcc_generated_files/timer/tce0.h"
 #include "stepper.h"
+#include "step_dir.h"
+#include "encoder.h"
 
 
 #define V_OUT                                   (R)*(I_OUT)  /* Output Voltage [mV] */
 #define K_COMP                                  (1000000000.0 * (float)KV/(float)K_MODE)
 
+/* Integer forms used by the tick: V_OUT in mV and K_COMP in units of 2^15 */
+#define V_OUT_MV                                (uint16_t)(V_OUT + 0.5)
+#define K_COMP_Q15                              (uint32_t)(K_COMP / 32768.0 + 0.5)
 
-/* Flag set by interrupt */
-static volatile bool     time_flag;
-
-#if STEPPING_MODE == MICRO_STEP
-static const uint16_t sine_lookup_table[32] = 
-{
-    AMP_TO_U16(0.024541229),
-    AMP_TO_U16(0.073564564),
-    AMP_TO_U16(0.122410675),
-    AMP_TO_U16(0.170961889),
-    AMP_TO_U16(0.21910124),
-    AMP_TO_U16(0.266712757),
-    AMP_TO_U16(0.31368174),
-    AMP_TO_U16(0.359895037),
-    AMP_TO_U16(0.405241314),
-    AMP_TO_U16(0.44961133),
-    AMP_TO_U16(0.492898192),
-    AMP_TO_U16(0.53499762),
-    AMP_TO_U16(0.575808191),
-    AMP_TO_U16(0.615231591),
-    AMP_TO_U16(0.653172843),
-    AMP_TO_U16(0.689540545),
-    AMP_TO_U16(0.724247083),
-    AMP_TO_U16(0.757208847),
-    AMP_TO_U16(0.788346428),
-    AMP_TO_U16(0.817584813),
-    AMP_TO_U16(0.844853565),
-    AMP_TO_U16(0.870086991),
-    AMP_TO_U16(0.893224301),
-    AMP_TO_U16(0.914209756),
-    AMP_TO_U16(0.932992799),
-    AMP_TO_U16(0.949528181),
-    AMP_TO_U16(0.963776066),
-    AMP_TO_U16(0.97570213),
-    AMP_TO_U16(0.985277642),
-    AMP_TO_U16(0.992479535),
-    AMP_TO_U16(0.997290457),
-    AMP_TO_U16(0.999698819)
+/* Closed loop current in 1/256 of the rated current: at no error, and added per sub-step of error up to the rated one */
+#define CLOSED_LOOP_CURRENT_FULL                256
+#define CLOSED_LOOP_CURRENT_BASE                (uint16_t)(CLOSED_LOOP_CURRENT_MIN * 256.0 + 0.5)
+#define CLOSED_LOOP_CURRENT_GAIN                (uint16_t)((CLOSED_LOOP_CURRENT_FULL - CLOSED_LOOP_CURRENT_BASE) / (CLOSED_LOOP_FULL_ERROR + 0.5))
+
+
+#define QUEUE_MASK                              (STEPPER_QUEUE_SIZE - 1)
+
+/* One queued movement. The planner (main loop) writes exit_speed and steps_until_stop, the tick reads them. */
+typedef struct
+{
+    uint32_t steps;
+    uint32_t steps_until_stop;
+    uint32_t speed_limit;
+    uint32_t peak_speed;                        /* S-curve only: highest speed planned for the segment */
+    uint32_t entry_speed;                       /* Written by the tick when the segment is started */
+    uint32_t exit_speed;
+    uint16_t acceleration;
+    uint16_t deceleration;
+    uint16_t jerk;                              /* 0: trapezoid, otherwise S-curve */
+    bool     direction;
+} stepper_segment_t;
+
+/* Ring buffer of movements: filled by Stepper_MoveStart, drained by the TCE0 tick.
+ * The segment at queue_head stays in the queue while it is executed. */
+static stepper_segment_t   queue[STEPPER_QUEUE_SIZE];
+static volatile uint8_t    queue_head;
+static volatile uint8_t    queue_tail;
+static volatile bool       segment_active;
+
+/* Motion state owned by the TCE0 tick */
+static stepper_position_t  actual_position;
+static uint32_t            steps_to_go;
+static uint32_t            actual_speed;
+static uint16_t            amplitude;
+static bool                direction;
+
+/* Velocity mode: target speed, direction and rates written by Stepper_VelocitySet, followed by the tick */
+static volatile bool       velocity_mode;
+static uint32_t            velocity_speed;
+static bool                velocity_direction;
+static uint16_t            velocity_acceleration;
+static uint16_t            velocity_deceleration;
+
+/* STEP/DIR mode: the sub-steps per pulse and the filtered step rate, 65536 being one sub-step per tick.
+ * step_dir_stop asks the tick to end the mode. */
+static volatile bool       step_dir_mode;
+static volatile bool       step_dir_stop;
+static uint8_t             step_dir_ratio;
+static uint32_t            step_dir_rate;
+
+/* STEP/DIR interpolation: distance from the motor to the commanded position, in sub-steps with 16 fractional bits,
+ * ticks since the last pulse, and the speed that covers the distance in the last pulse period */
+static int32_t             step_dir_lag;
+static uint16_t            step_dir_ticks;
+static uint16_t            step_dir_speed;
+
+/* Quick stop: request and its time, written by Stepper_QuickStop, and the stop in progress */
+static volatile bool       quick_stop_request;
+static volatile bool       quick_stop_active;
+static uint16_t            quick_stop_ticks;
+static uint16_t            quick_stop_clock;
+static volatile uint16_t   stop_latency;
+static stepper_stop_cb_t   stop_callback;
+
+/* Called when the motor comes to standstill, from the tick or from Stepper_Abort */
+static stepper_stop_cb_t   idle_callback;
+
+/* Position compare, a list or an interval, and the pulse on the output pin. compare_phase is (position - origin) modulo
+ * the interval, compare_index the number of list entries up to the position. */
+static const stepper_position_t *compare_list;
+static uint8_t             compare_count;
+static uint8_t             compare_index;
+static uint16_t            compare_interval;
+static uint16_t            compare_phase;
+static stepper_position_t  compare_origin;
+static bool                compare_pulse;
+static volatile uint16_t   compare_pulses;
+
+/* Encoder feedback: the rotor position measured by the encoder in sub-steps, with the remainder of the conversion from
+ * counts in 1 / ENCODER_COUNTS_PER_REV of a sub-step, so the tick follows it without a division. The encoder count
+ * last read by the tick, and the following error limit in sub-steps. */
+static stepper_position_t  encoder_position;
+static int32_t             encoder_fraction;
+static uint16_t            encoder_count;
+static stepper_position_t  follow_limit;
+static volatile bool       follow_error_flag;
+static stepper_stop_cb_t   follow_error_callback;
+
+/* Closed loop: active, or ticks left holding the commanded angle before the encoder is aligned and the loop closed */
+static volatile bool       closed_loop;
+static volatile uint16_t   closed_loop_align;
+
+/* Ticks since Stepper_Init, the time base of the stop latency */
+static volatile uint16_t   tick_count;
+
+/* Longest tick since Stepper_Init, in TCE0 clocks from the start of the PWM period */
+static volatile uint16_t   tick_clocks_max;
+
+/* S-curve state. The acceleration is kept as magnitude and sign, in the speed unit with 8 fractional bits. */
+static uint8_t             speed_fraction;
+static uint32_t            actual_accel;
+static bool                accel_up;
+static uint32_t            ramp_dv;             /* Speed change still produced if the acceleration is ramped down to zero now */
+
+/* Supply voltage, written by Stepper_VBusSet and converted by the tick into amplitude and compensation terms.
+ * 1/supply_mv is kept as vbus_inverse / 2^(30 - 15 + vbus_shift), vbus_inverse being normalized to 16384 ... 32768. */
+static volatile uint16_t   supply_mv;
+static volatile bool       vbus_updated;
+static uint16_t            vbus_inverse;
+static uint8_t             vbus_shift;
+
+/* 2^30 / n for n = 32768 ... 65536 in steps of 512 */
+static const uint16_t reciprocal_table[65] =
+{
+    32768, 32264, 31775, 31301, 30840, 30394, 29959, 29537,
+    29127, 28728, 28340, 27962, 27594, 27236, 26887, 26546,
+    26214, 25891, 25575, 25267, 24966, 24672, 24385, 24105,
+    23831, 23564, 23302, 23046, 22795, 22550, 22310, 22075,
+    21845, 21620, 21400, 21183, 20972, 20764, 20560, 20361,
+    20165, 19973, 19784, 19600, 19418, 19240, 19065, 18893,
+    18725, 18559, 18396, 18236, 18079, 17924, 17772, 17623,
+    17476, 17332, 17190, 17050, 16913, 16777, 16644, 16513,
+    16384
 };
-#else /* STEPPING_MODE */
-typedef enum
-{
-    CW_STEP_0 = 0,
-    CW_STEP_45 = 1,
-    CW_STEP_90 = 2,
-    CW_STEP_135 = 3,
-    CW_STEP_180 = 4,
-    CW_STEP_225 = 5,
-    CW_STEP_270 = 6,
-    CW_STEP_315 = 7,
-    
-    
-    CCW_STEP_0 = 8,
-    CCW_STEP_45 = 9,
-    CCW_STEP_90 = 10,
-    CCW_STEP_135 = 11,
-    CCW_STEP_180 = 12,
-    CCW_STEP_225 = 13,
-    CCW_STEP_270 = 14,
-    CCW_STEP_315 = 15
-} step_t;
-#endif /* STEPPING_MODE  */
-
-/* Doesn't reset the counter */
-#define NO_CMD      false
-
-/* Reset the counter */
-#define RESET_CMD   true
-
-/* This function returns true if the delay for the next step expired */
-static inline bool CheckSteps(bool reset_cmd, uint16_t actual_speed)
-{
-    static uint16_t counter = 0;
-    uint16_t pre_counter;
-    
-    if(reset_cmd == RESET_CMD)
-    {
-        counter = 0;
-        return false;
+
+/* Profile applied to the movements queued next */
+static stepper_profile_t   profile;
+static uint16_t            profile_jerk;
+
+/* Coil drive lookup
+ * The electrical angle is a 32-bit accumulator covering one electrical period (4 full-steps) and advanced by the speed
+ * every tick. Its top 10 bits are the angle in 1/256 of a full-step, ELECTRICAL_PERIOD entries per period, independently
+ * of K_MODE. The lower bits keep the fraction of an entry, so low speeds are not rounded.
+ * The angle is rounded to the active resolution before it is applied to the coils.
+ * In every quarter of the period one channel is driven with sine_table[k] and another one with sine_table[256 - k],
+ * k being the position inside the quarter. The other two channels are zero. */
+#define ELECTRICAL_PERIOD                       (4 * STEPPER_RESOLUTION_MAX)
+#define ELECTRICAL_MASK                         (ELECTRICAL_PERIOD - 1)
+
+#define PHASE_TO_ANGLE(phase)                   ((uint16_t)((phase) >> 22))
+#define PHASE_PER_SUBSTEP                       (0x40000000UL / K_MODE)
+#define PHASE_PER_SPEED                         (PHASE_PER_SUBSTEP >> 16)      /* Speed unit: 65536 is one sub-step per tick */
+#define SUBSTEP_MASK                            (4 * K_MODE - 1)
+
+/* Speed limit for each coil entry width, one entry per tick, and the highest one, at resolution 1: one full-step per tick */
+#define SPEED_PER_WIDTH                         ((uint32_t)65536 * K_MODE / STEPPER_RESOLUTION_MAX)
+#define SPEED_MAX                               STEPPER_SPEED_MAX(1)
+#define SQ_SPEED_MAX                            ((uint64_t)SPEED_MAX * SPEED_MAX)
+
+/* 257 entries of sin(i * 90 / 256 degrees), generated at compile time */
+#define SINE_PI                                 3.14159265358979
+#define SINE_ENTRY(i)                           AMP_TO_U16(__builtin_sin((i) * SINE_PI / (2.0 * STEPPER_RESOLUTION_MAX))),
+#define SINE_REP1(i)                            SINE_ENTRY(i)
+#define SINE_REP2(i)                            SINE_REP1(i)   SINE_REP1((i) + 1)
+#define SINE_REP4(i)                            SINE_REP2(i)   SINE_REP2((i) + 2)
+#define SINE_REP8(i)                            SINE_REP4(i)   SINE_REP4((i) + 4)
+#define SINE_REP16(i)                           SINE_REP8(i)   SINE_REP8((i) + 8)
+#define SINE_REP32(i)                           SINE_REP16(i)  SINE_REP16((i) + 16)
+#define SINE_REP64(i)                           SINE_REP32(i)  SINE_REP32((i) + 32)
+#define SINE_REP128(i)                          SINE_REP64(i)  SINE_REP64((i) + 64)
+#define SINE_REP256(i)                          SINE_REP128(i) SINE_REP128((i) + 128)
+
+static const uint16_t sine_table[STEPPER_RESOLUTION_MAX + 1] = { SINE_REP256(0) SINE_ENTRY(STEPPER_RESOLUTION_MAX) };
+
+/* Channels (0: a, 1: b, 2: c, 3: d) driven with the sine and with the cosine in each quarter of the electrical period */
+static const uint8_t sine_channel[4]   = { 3, 0, 2, 1 };
+static const uint8_t cosine_channel[4] = { 1, 3, 0, 2 };
+
+/* Electrical angle accumulator, sub-step (modulo one period) last reached by it,
+ * and the angle last seen */
+static uint32_t            electrical_phase;
+static uint16_t            substep_reached;
+static uint16_t            last_angle;
+
+/* Coil values computed in the tick, written to TCE0 once at its end */
+static uint16_t            coil_channel[4];
+static bool                coil_write;
+
+/* Coil resolution as the angle between two applied entries: in use, and requested by Stepper_ResolutionSet */
+static uint16_t            angle_width;
+static volatile uint16_t   angle_width_next;
+
+/* Advances the electrical angle by the speed of one tick. Returns the number of sub-steps reached, up to one
+ * full-step at the highest speed of resolution 1.
+ * Moving CCW, a sub-step is reached when the angle gets to it from above, so the position does not
+ * change when the direction is reversed between two sub-steps. */
+static inline uint8_t PhaseAdvance(uint32_t speed, bool direction)
+{
+    uint32_t increment = (uint32_t)speed * PHASE_PER_SPEED;
+    uint16_t substep;
+    int16_t  crossed;
+
+    if(direction)
+    {
+        electrical_phase -= increment;
+        substep = (uint16_t)((electrical_phase + (PHASE_PER_SUBSTEP - 1)) / PHASE_PER_SUBSTEP);
+        crossed = (int16_t)(substep_reached - substep);
     }
     else
     {
-        while(time_flag == false);
-        time_flag = false;
-
-        pre_counter = counter;
-        counter += actual_speed;
-        
-        /* This checks for overflow */
-        if(counter < pre_counter)
-            return true;
-        else
-            return false;
+        electrical_phase += increment;
+        substep = (uint16_t)(electrical_phase / PHASE_PER_SUBSTEP);
+        crossed = (int16_t)(substep - substep_reached);
     }
+
+    /* Signed distance on the ring of sub-steps, one electrical period. The speed is at most one full-step per tick. */
+    crossed = ((crossed + 2 * K_MODE) & SUBSTEP_MASK) - 2 * K_MODE;
+    if(crossed <= 0)
+        return 0;
+
+    substep_reached = substep & SUBSTEP_MASK;
+    return (uint8_t)crossed;
 }
 
-/* If parameter direction is True means that motor will spin in CCW */
-static void StepAdvance(bool direction)
-{  
-    uint16_t a = 0, b = 0, c = 0, d = 0;
-
-#if STEPPING_MODE == FULL_STEP    
-    static step_t step = 0;
-    /*These masks are correlated with step_t */
-    step &= 7;
-    if(direction) step |= 8;
-
-    switch(step)
-    {
-        case CW_STEP_270:   a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CW_STEP_180;     break;
-        case CW_STEP_180:   a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CW_STEP_90;      break;
-        case CW_STEP_90:    a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_FULL; d = DRIVE_ZERO; step = 0;               break;
-        case CW_STEP_0:     a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_FULL; step = CW_STEP_270;     break;
-
-        case CCW_STEP_0:    a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_FULL; step = CCW_STEP_90;     break;                  
-        case CCW_STEP_90:   a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_FULL; d = DRIVE_ZERO; step = CCW_STEP_180;    break;
-        case CCW_STEP_180:  a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CCW_STEP_270;    break;
-        case CCW_STEP_270:  a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CCW_STEP_0;      break;
-
-        default:            a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_0;       break; 
-    }   
-#endif /* STEPPING_MODE==FULL_STEP */
-
-#if STEPPING_MODE == HALF_STEP
-    static step_t step = 0;
-    /*These masks are correlated with step_t */
-    step &= 7;
-    if(direction) step |= 8;
-    
-    switch(step)
-    {
-        case CW_STEP_315:  a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_ZERO; d = DRIVE_HALF; step = CW_STEP_270;      break;  
-        case CW_STEP_270:  a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CW_STEP_225;      break;
-        case CW_STEP_225:  a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_HALF; step = CW_STEP_180;      break;
-        case CW_STEP_180:  a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_135;      break;
-        case CW_STEP_135:  a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_HALF; d = DRIVE_ZERO; step = CW_STEP_90;       break;
-        case CW_STEP_90:   a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CW_STEP_45;       break;
-        case CW_STEP_45:   a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_HALF; d = DRIVE_ZERO; step = CW_STEP_0;        break;
-        case CW_STEP_0:    a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_315;      break;  
-        
-        case CCW_STEP_0:   a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CCW_STEP_45;      break;                  
-        case CCW_STEP_45:  a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_HALF; d = DRIVE_ZERO; step = CCW_STEP_90;      break;
-        case CCW_STEP_90:  a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CCW_STEP_135;     break;
-        case CCW_STEP_135: a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_HALF; d = DRIVE_ZERO; step = CCW_STEP_180;     break;
-        case CCW_STEP_180: a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CCW_STEP_225;     break;                  
-        case CCW_STEP_225: a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_HALF; step = CCW_STEP_270;     break;
-        case CCW_STEP_270: a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CCW_STEP_315;     break;
-        case CCW_STEP_315: a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_ZERO; d = DRIVE_HALF; step = CCW_STEP_0;       break;
-        
-        default:           a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_0;        break;               
-    }    
-#endif /* STEPPING_MODE==HALF_STEP */
-    
-#if STEPPING_MODE == MICRO_STEP
-    static uint8_t step = 0;
-    uint8_t x = (step & 0x60) | direction;
-       
-    switch(x)
-    {
-        /* CW */
-        case 0x00:  a = 0;
-                    b = sine_lookup_table[31 - (step & 0x1F)];
-                    c = 0;
-                    d = sine_lookup_table[step & 0x1F];;
-                    break;
-        case 0x20: 
-                    a = sine_lookup_table[step & 0x1F];
-                    b = 0;
-                    c = 0;
-                    d = sine_lookup_table[31 - (step & 0x1F)];
-                    break;
-        case 0x40:            
-                    a = sine_lookup_table[31 - (step & 0x1F)];
-                    b = 0;
-                    c = sine_lookup_table[step & 0x1F];;
-                    d = 0;
-                    break;     
-        case 0x60: 
-                    a = 0;
-                    b = sine_lookup_table[step & 0x1F];
-                    c = sine_lookup_table[31 - (step & 0x1F)];
-                    d = 0;                  
-                    break;
-        
-        /* CCW */
-        case 0x01: 
-                    a = 0;
-                    b = sine_lookup_table[31 - (step & 0x1F)];
-                    c = sine_lookup_table[step & 0x1F];
-                    d = 0;                  
-                    break;
-        case 0x21: 
-                    a = sine_lookup_table[step & 0x1F];
-                    b = 0;
-                    c = sine_lookup_table[31 - (step & 0x1F)];
-                    d = 0;          
-                    break;
-        case 0x41: 
-                    a = sine_lookup_table[31 - (step & 0x1F)];
-                    b = 0;
-                    c = 0;
-                    d = sine_lookup_table[step & 0x1F];            
-                    break;
-        case 0x61:           
-                    a = 0;
-                    b = sine_lookup_table[step & 0x1F];
-                    c = 0;
-                    d = sine_lookup_table[31 - (step & 0x1F)];            
-                    break;
-                    
-        default:   a = 0; b = 0; c = 0; d = 0; break;           
-    }
-    step++; step &= 0x7F;
-#endif /* STEPPING_MODE == MICRO_STEP */
-    TCE0_CompareAllChannelsBufferedSet(a, b, c, d);
-}
-
-/* This function is registered as a callback and must be called once in 50 us. */
-void Stepper_TimeTick(void)
+/* Coil values of an applied angle, one per channel. At resolution 1 both coils take the last entry, DRIVE_FULL, as the
+ * classic full-step drive: full is 1 there and clears the position inside the quarter from both indexes. */
+static void CoilChannels(uint16_t angle, uint16_t *channel)
 {
-    time_flag = true;
+    uint8_t  quarter = (uint8_t)(angle >> 8);
+    uint16_t k = angle & 0xFF;
+    uint16_t full = angle_width >> 8;
+    uint16_t keep = full - 1;
+
+    channel[0] = DRIVE_ZERO;
+    channel[1] = DRIVE_ZERO;
+    channel[2] = DRIVE_ZERO;
+    channel[3] = DRIVE_ZERO;
+    channel[sine_channel[quarter]]   = sine_table[(k & keep) | (full << 8)];
+    channel[cosine_channel[quarter]] = sine_table[((STEPPER_RESOLUTION_MAX - k) & keep) | (full << 8)];
 }
 
+/* Applies an electrical angle to the coils, rounded to the active resolution. It is electrical_phase, or in closed loop
+ * the angle placed against the rotor.
+ * The full-step positions (both coils at equal current) are common to all resolutions,
+ * so a new resolution is taken over when the angle crosses one of them.
+ * The coil values can only change at the PWM update, once per tick. If the rounded angle changes during the next
+ * PWM period, the values written for that period are the old and the new ones weighted by the time spent at each,
+ * taken from the fraction of the phase accumulator. The current then follows the exact step time instead of
+ * jumping on the next tick, which removes the step period jitter at high speed and coarse resolutions.
+ * Nothing depends on the angle, the direction or the resolution but the values: the direction is a sign mask, the
+ * conditions are masks, and every tick blends the applied entry with the next one, with the whole period on the
+ * applied one when no change falls in it. So every tick takes the same time, the one of a step. */
+static void StepAdvance(uint32_t phase, uint32_t speed, bool direction)
+{
+    uint16_t channel[4];
+    uint16_t next[4];
+    uint16_t angle = PHASE_TO_ANGLE(phase);
+    uint32_t increment = (uint32_t)speed * PHASE_PER_SPEED;
+    uint32_t reverse = 0 - (uint32_t)direction;
+    uint16_t sign = (uint16_t)reverse;
+    uint16_t crossed = ((last_angle + 128) ^ (angle + 128)) & (ELECTRICAL_MASK & ~0xFF);
+    uint16_t full;
+    uint16_t width;
+    uint32_t distance;
+    uint32_t divisor;
+    uint32_t blend;
+    uint16_t fraction = 0;
+    uint8_t  k;
 
-void Stepper_Init(void)
+    /* All ones past a full-step position, where a new resolution is taken over */
+    crossed = 0 - (uint16_t)(crossed != 0);
+    angle_width ^= (angle_width ^ angle_width_next) & crossed;
+    last_angle = angle;
+    width = angle_width;
+    full = width >> 8;
+
+    /* Round to the nearest entry of the active resolution. Resolution 1 uses the full-step positions, the middle of
+     * the quarters. */
+    angle = (PHASE_TO_ANGLE(phase + ((uint32_t)(width & 0xFF) << 21)) & ~(width - 1)) | (full << 7);
+
+    /* Phase left until the rounded angle changes, half an entry away from the applied one.
+     * Only a single change per period is blended: the speed limit of the resolution keeps the motor at one entry per
+     * tick at most, except in the STEP/DIR mode, where the angle is applied as the pulses come. */
+    distance = ((uint32_t)(uint16_t)(angle + (((width / 2) ^ sign) - sign)) << 22) - phase;
+    distance = (distance ^ reverse) - reverse;
+    blend = 0 - (uint32_t)((distance < increment) & (increment <= ((uint32_t)width << 22)));
+
+    /* fraction = 256 * distance / increment: the part of the period still spent at the applied angle */
+    divisor = increment;
+    for(k = 0; k < 8; k++)
+    {
+        uint32_t take;
+
+        divisor >>= 1;
+        take = 0 - (uint32_t)(distance >= divisor);
+        distance -= divisor & take;
+        fraction = (uint16_t)((fraction << 1) | (take & 1));
+    }
+    fraction = 256 - ((256 - fraction) & (uint16_t)blend);
+
+    CoilChannels(angle, channel);
+    CoilChannels((angle + ((width ^ sign) - sign)) & ELECTRICAL_MASK, next);
+    for(k = 0; k < 4; k++)
+        channel[k] = (uint16_t)(((uint32_t)channel[k] * fraction + (uint32_t)next[k] * (256 - fraction)) >> 8);
+
+    coil_channel[0] = channel[0];
+    coil_channel[1] = channel[1];
+    coil_channel[2] = channel[2];
+    coil_channel[3] = channel[3];
+    coil_write = true;
+}
+
+/* Sets the coil values of the tick to zero: the coils are released at the next PWM update */
+static inline void CoilRelease(void)
 {
-    time_flag = false;
-    /* Enable hardware scaling accelerator after initialization */
-    TCE0_ScaleEnable(true);
-    TCE0_AmplitudeSet(DRIVE_ZERO);
-    TCE0_CompareAllChannelsBufferedSet(DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO);
+    coil_channel[0] = DRIVE_ZERO;
+    coil_channel[1] = DRIVE_ZERO;
+    coil_channel[2] = DRIVE_ZERO;
+    coil_channel[3] = DRIVE_ZERO;
+    coil_write = true;
 }
 
-static inline void AmplitudeSet(uint16_t amplitude)
+static inline void AmplitudeSet(uint32_t amplitude)
 {
     if(amplitude > 32768)
         amplitude = 32768;
-    TCE0_AmplitudeSet(amplitude);
+    TCE0_AmplitudeSet((uint16_t)amplitude);
 }
 
-stepper_position_t Stepper_Move(stepper_position_t initial_position, stepper_position_t steps, uint16_t acceleration, uint16_t deceleration, uint16_t speed_limit, uint16_t vbus_mv)
-{  
-    stepper_position_t actual_position = initial_position;
-    uint16_t actual_speed = 0;
-    bool direction;
-    uint32_t steps_to_go;
-    uint32_t steps_until_stop = 0;
-    
-    uint16_t amplitude;
-    uint32_t compensation;
-   
-    /* Preparing the computations */
-    if(vbus_mv == 0)
+/* Computes the reciprocal of the supply voltage and the drive amplitude V_OUT / supply_mv, without a division.
+ * The voltage is normalized to 32768 ... 65535 and the reciprocal is interpolated from reciprocal_table. */
+static void VBusUpdate(void)
+{
+    uint16_t vbus = supply_mv;
+    uint16_t inverse;
+    uint32_t new_amplitude;
+    uint8_t  index;
+
+    vbus_updated = false;
+    if(vbus == 0)
     {
-        amplitude    = AMP_TO_U16(0.0);
-        compensation = AMP_TO_U16(0.0);
+        /* No drive */
+        vbus_inverse = 0;
+        vbus_shift = 0;
+        amplitude = AMP_TO_U16(0.0);
+        return;
     }
-    else if(vbus_mv <= (uint16_t)V_OUT)
+
+    vbus_shift = 15;
+    while((vbus & 0x8000) == 0)
     {
-        amplitude    = AMP_TO_U16(1.0);
-        compensation = AMP_TO_U16(1.0);
+        vbus <<= 1;
+        vbus_shift--;
     }
-    else
+    index = (uint8_t)((vbus >> 9) & 0x3F);
+    inverse = reciprocal_table[index];
+    inverse -= (uint16_t)(((uint32_t)(inverse - reciprocal_table[index + 1]) * (vbus & 0x1FF)) >> 9);
+    vbus_inverse = inverse;
+
+    /* At or below V_OUT the coils are driven with the full amplitude */
+    new_amplitude = ((uint32_t)V_OUT_MV * inverse) >> vbus_shift;
+    amplitude = (new_amplitude > 32768) ? 32768 : (uint16_t)new_amplitude;
+}
+
+/* Starts the segment at the head of the queue. Returns false if the queue is empty. */
+static inline bool SegmentLoad(void)
+{
+    stepper_segment_t *segment;
+
+    if(queue_head == queue_tail)
+        return false;
+
+    segment = &queue[queue_head];
+    if(actual_speed == 0)
     {
-        amplitude    = AMP_TO_U16(V_OUT  / (float)vbus_mv);
-        compensation = (uint32_t)(K_COMP / (float)vbus_mv);
+        /* Starting from standstill */
+        AmplitudeSet(amplitude);
+        speed_fraction = 0;
     }
-    
-    if(steps < 0)
+    if((actual_speed == 0) || (segment->jerk == 0))
+    {
+        actual_accel = 0;
+        ramp_dv = 0;
+    }
+    segment->entry_speed = actual_speed;
+    steps_to_go = segment->steps;
+    direction = segment->direction;
+    segment_active = true;
+    return true;
+}
+
+/* Lowers the magnitude of the acceleration by one jerk step */
+static inline void AccelDecrease(uint16_t jerk)
+{
+    if(actual_accel > jerk)
     {
-        direction = true;
-        steps_to_go = (uint32_t)(0 - steps);
+        ramp_dv -= actual_accel;
+        actual_accel -= jerk;
     }
     else
     {
-        direction = false;
-        steps_to_go = (uint32_t)steps;
+        actual_accel = 0;
+        ramp_dv = 0;
     }
+}
 
-    uint64_t sq_speed_limit = (uint64_t)speed_limit * (uint64_t)speed_limit;
-    uint64_t sq_speed_top   = 2 * (uint64_t)acceleration * (uint64_t)deceleration * (uint64_t)steps_to_go * 65536 / (acceleration + deceleration);
+/* Jerk-limited speed update, called once per tick. The acceleration changes by at most jerk
+ * per tick and is ramped back to zero in time to reach the target speed without overshoot. */
+static inline void SCurveUpdate(uint32_t target, uint16_t max_rate, uint16_t jerk)
+{
+    uint32_t speed = (actual_speed << 8) | speed_fraction;
+    uint32_t goal  = target << 8;
+    bool     up    = (goal > speed);
+    uint32_t dv    = up ? (goal - speed) : (speed - goal);
+
+    if(dv == 0)
+    {
+        actual_accel = 0;
+        ramp_dv = 0;
+        return;
+    }
 
-    if(sq_speed_top > sq_speed_limit)
+    if((accel_up != up) && (actual_accel != 0))
     {
-        /* Trapezoidal profile: acceleration, constant speed, deceleration */
-        steps_until_stop = (uint32_t)(sq_speed_limit / (2 * 65536 * deceleration));
+        /* Accelerating the wrong way, bring the acceleration through zero first */
+        AccelDecrease(jerk);
+    }
+    else if(ramp_dv >= dv)
+    {
+        /* Start rounding the corner into the target speed */
+        accel_up = up;
+        AccelDecrease(jerk);
     }
     else
     {
-        /* Triangular profile: acceleration, deceleration */
-        steps_until_stop = (uint32_t)(acceleration * steps_to_go / (acceleration + deceleration));
+        uint32_t rate = (uint32_t)max_rate << 8;
+
+        accel_up = up;
+        if(actual_accel + jerk <= rate)
+        {
+            actual_accel += jerk;
+            ramp_dv += actual_accel;
+        }
+        else if(actual_accel < rate)
+        {
+            actual_accel = rate;
+            ramp_dv += rate;
+        }
     }
 
-    CheckSteps(RESET_CMD, 0);
-        
-    AmplitudeSet(amplitude);
-    
-    /* Now start moving */
-    while(steps_to_go != 0)
+    if(accel_up)
+    {
+        speed += actual_accel;
+        if(up && (speed >= goal))
+        {
+            speed = goal;
+            actual_accel = 0;
+            ramp_dv = 0;
+        }
+    }
+    else
+    {
+        speed = (speed > actual_accel + 256) ? (speed - actual_accel) : 256;
+        if((up == false) && (speed <= goal))
+        {
+            speed = goal;
+            actual_accel = 0;
+            ramp_dv = 0;
+        }
+    }
+    actual_speed = speed >> 8;
+    speed_fraction = (uint8_t)speed;
+}
+
+/* Velocity mode speed update: ramps towards the target speed with the per-tick rates. Reversing, the speed is
+ * first brought down to zero with the deceleration and the motor continues in the new direction on the next tick. */
+static inline void VelocityUpdate(void)
+{
+    if(direction != velocity_direction)
+    {
+        if(actual_speed > velocity_deceleration)
+        {
+            actual_speed -= velocity_deceleration;
+        }
+        else
+        {
+            actual_speed = 0;
+            direction = velocity_direction;
+        }
+    }
+    else if(actual_speed < velocity_speed)
+    {
+        actual_speed = (actual_speed + velocity_acceleration < velocity_speed) ? (actual_speed + velocity_acceleration) : velocity_speed;
+    }
+    else if(actual_speed > velocity_speed)
+    {
+        actual_speed = (actual_speed > velocity_speed + velocity_deceleration) ? (actual_speed - velocity_deceleration) : velocity_speed;
+    }
+}
+
+/* Starts a compare pulse when the sub-step just reached moves the position between X - 1 and X, X being a list entry
+ * or origin + k * interval. Up to one sub-step per tick every crossing gets its own tick. */
+static inline void PositionCompare(bool reverse)
+{
+    bool hit = false;
+
+    if(compare_interval != 0)
     {
-        /* Verifying the speed profile: acceleration, deceleration and constant speed */
-        if(steps_to_go > steps_until_stop)
+        if(reverse == false)
         {
-            if(actual_speed < (speed_limit - acceleration))
+            if(++compare_phase == compare_interval)
             {
-                actual_speed += acceleration;
+                compare_phase = 0;
+                hit = true;
             }
-            else if(actual_speed < speed_limit) actual_speed++;
         }
         else
         {
-            if(actual_speed > deceleration)
+            /* Leaving X downwards */
+            if(compare_phase == 0)
+            {
+                compare_phase = compare_interval;
+                hit = true;
+            }
+            compare_phase--;
+        }
+    }
+    else if(compare_list != NULL)
+    {
+        if(reverse == false)
+        {
+            if((compare_index < compare_count) && (compare_list[compare_index] == actual_position))
             {
-                actual_speed -= deceleration;
+                compare_index++;
+                hit = true;
             }
-            else if(actual_speed > 1) actual_speed--;
         }
-        uint16_t dynamic_amp = (uint16_t)((compensation * (uint32_t)actual_speed) >> 16);
+        else if((compare_index > 0) && (compare_list[compare_index - 1] == actual_position + 1))
+        {
+            compare_index--;
+            hit = true;
+        }
+    }
+
+    if(hit)
+    {
+        POSITION_COMPARE_PORT.OUTSET = POSITION_COMPARE_PIN_bm;
+        compare_pulse = true;
+        compare_pulses++;
+    }
+}
 
-        AmplitudeSet(amplitude + dynamic_amp);
-        
-        bool b = CheckSteps(NO_CMD, actual_speed);
-        if(b)
+/* Position compare for a tick of several sub-steps, already applied to actual_position: every position crossed counts
+ * as in PositionCompare. The crossings of one tick share the same pulse. The loops run once per crossing, not per sub-step. */
+static void PositionCompareJump(uint32_t steps, bool reverse)
+{
+    uint16_t hits = 0;
+
+    if(compare_interval != 0)
+    {
+        if(reverse == false)
+        {
+            uint32_t phase = compare_phase + steps;
+
+            while(phase >= compare_interval)
+            {
+                phase -= compare_interval;
+                hits++;
+            }
+            compare_phase = (uint16_t)phase;
+        }
+        else
+        {
+            /* Leaving X downwards takes compare_phase + 1 sub-steps, the next ones compare_interval each */
+            while(steps > compare_phase)
+            {
+                steps -= (uint32_t)compare_phase + 1;
+                compare_phase = compare_interval - 1;
+                hits++;
+            }
+            compare_phase -= (uint16_t)steps;
+        }
+    }
+    else if(compare_list != NULL)
+    {
+        if(reverse == false)
+        {
+            while((compare_index < compare_count) && (compare_list[compare_index] <= actual_position))
+            {
+                compare_index++;
+                hits++;
+            }
+        }
+        else
         {
-            steps_to_go--;
-            StepAdvance(direction);
-            if(direction) actual_position--;
-            else          actual_position++;
+            while((compare_index > 0) && (compare_list[compare_index - 1] > actual_position))
+            {
+                compare_index--;
+                hits++;
+            }
         }
     }
-    /* Movement completed. Now the motor is stopped. */
+
+    if(hits != 0)
+    {
+        POSITION_COMPARE_PORT.OUTSET = POSITION_COMPARE_PIN_bm;
+        compare_pulse = true;
+        compare_pulses += hits;
+    }
+}
+
+/* Places the compare state on the actual position */
+static void CompareSync(void)
+{
+    if(compare_interval != 0)
+    {
+        int32_t phase = (actual_position - compare_origin) % (int32_t)compare_interval;
+
+        compare_phase = (uint16_t)((phase < 0) ? (phase + compare_interval) : phase);
+    }
+    compare_index = 0;
+    while((compare_index < compare_count) && (compare_list[compare_index] <= actual_position))
+        compare_index++;
+}
+
+/* Amplitude of the BEMF compensation: K_COMP * actual_speed / supply_mv. Above one sub-step per tick the whole sub-steps
+ * are multiplied apart, and the term is saturated: it is far above the full amplitude there. */
+static inline uint32_t DynamicAmplitude(void)
+{
+    uint32_t bemf = ((uint32_t)K_COMP_Q15 * (uint16_t)actual_speed) >> 16;
+
+    if(actual_speed > UINT16_MAX)
+    {
+        bemf += (uint32_t)K_COMP_Q15 * (uint16_t)(actual_speed >> 16);
+        if(bemf > UINT16_MAX)
+            bemf = UINT16_MAX;
+    }
+    return (bemf * vbus_inverse) >> vbus_shift;
+}
+
+#if (ENCODER_FEEDBACK == true)
+/* Closed loop: the field is placed at most CLOSED_LOOP_LOAD_ANGLE ahead of the rotor measured by the encoder, so the
+ * torque never reverses and no step is lost; within the load angle it is the commanded angle. The current follows the
+ * error instead of the fixed amplitude: CLOSED_LOOP_CURRENT_MIN at no error, the rated current from
+ * CLOSED_LOOP_FULL_ERROR on, with the BEMF compensation on top. Most of the added time is in the two 32-bit
+ * multiplications; Stepper_TickClocksMaxGet gives the whole tick measured on the target. */
+static void ClosedLoopDrive(uint32_t speed, bool direction)
+{
+    int32_t  error = actual_position - encoder_position;
+    uint32_t phase = electrical_phase;
+    uint32_t magnitude = (error < 0) ? (uint32_t)(-error) : (uint32_t)error;
+    uint16_t current = CLOSED_LOOP_CURRENT_FULL;
+
+    if(error > CLOSED_LOOP_LOAD_ANGLE)
+        phase -= (uint32_t)(error - CLOSED_LOOP_LOAD_ANGLE) * PHASE_PER_SUBSTEP;
+    else if(error < -CLOSED_LOOP_LOAD_ANGLE)
+        phase += (uint32_t)(-CLOSED_LOOP_LOAD_ANGLE - error) * PHASE_PER_SUBSTEP;
+
+    if(magnitude < CLOSED_LOOP_FULL_ERROR)
+        current = CLOSED_LOOP_CURRENT_BASE + (uint16_t)magnitude * CLOSED_LOOP_CURRENT_GAIN;
+    AmplitudeSet((((uint32_t)amplitude * current) >> 8) + DynamicAmplitude());
+    StepAdvance(phase, speed, direction);
+}
+#endif /* ENCODER_FEEDBACK */
+
+/* Drives the coils for one tick, at the electrical angle with the BEMF compensated amplitude, or in closed loop */
+static inline void DriveApply(uint32_t speed, bool direction)
+{
+#if (ENCODER_FEEDBACK == true)
+    if(closed_loop)
+    {
+        ClosedLoopDrive(speed, direction);
+        return;
+    }
+#endif
+    AmplitudeSet(amplitude + DynamicAmplitude());
+    StepAdvance(electrical_phase, speed, direction);
+}
+
+/* Takes back sub-steps reached in this tick: the electrical angle is placed on the sub-step before them */
+static void PhaseBack(uint8_t steps)
+{
+    substep_reached = (uint16_t)(direction ? (substep_reached + steps) : (substep_reached - steps)) & SUBSTEP_MASK;
+    electrical_phase = (uint32_t)substep_reached * PHASE_PER_SUBSTEP;
+}
+
+/* Drives the motor with actual_speed for one tick, at most steps_max sub-steps. Returns the number of sub-steps reached. */
+static inline uint8_t MotorAdvance(uint8_t steps_max)
+{
+    uint8_t steps = PhaseAdvance(actual_speed, direction);
+
+    if(steps > steps_max)
+    {
+        PhaseBack(steps - steps_max);
+        steps = steps_max;
+    }
+    if(steps == 1)
+    {
+        if(direction) actual_position--;
+        else          actual_position++;
+        PositionCompare(direction);
+    }
+    else if(steps != 0)
+    {
+        actual_position += direction ? -(stepper_position_t)steps : (stepper_position_t)steps;
+        PositionCompareJump(steps, direction);
+    }
+    DriveApply(actual_speed, direction);
+    return steps;
+}
+
+/* Movement completed. Now the motor is stopped, exactly on the last sub-step. */
+static void MotorStop(void)
+{
     actual_speed = 0;
+    electrical_phase = (uint32_t)substep_reached * PHASE_PER_SUBSTEP;
+    angle_width = angle_width_next;
+
+#if (ENCODER_FEEDBACK == true)
+    /* The closed loop keeps holding the position */
+    if(closed_loop)
+        return;
+#endif
     AmplitudeSet(amplitude);
-    
+
     /* Release the current through coils */
 #if (RELEASE_IN_IDLE == true)
-    TCE0_CompareAllChannelsBufferedSet(DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO);
+    CoilRelease();
+#else
+    /* Hold the last sub-step, without a blend towards the next one */
+    StepAdvance(electrical_phase, 0, direction);
 #endif /* RELEASE_IN_IDLE */
-    
-    return actual_position;
 }
 
+/* End of the movement, the velocity mode or the STEP/DIR mode: the motor is stopped and the callbacks get the position */
+static void MotionEnd(void)
+{
+    MotorStop();
+    if(quick_stop_active)
+    {
+        quick_stop_active = false;
+        if(stop_callback != NULL)
+            stop_callback(actual_position);
+    }
+    if(idle_callback != NULL)
+        idle_callback(actual_position);
+}
+
+/* Moves the electrical angle, the sub-step reached and the position by whole sub-steps at once, with the position compare */
+static void StepDirJump(uint32_t steps, bool reverse)
+{
+    uint32_t phase = steps * PHASE_PER_SUBSTEP;
+
+    if(reverse)
+    {
+        actual_position -= (stepper_position_t)steps;
+        electrical_phase -= phase;
+        substep_reached -= (uint16_t)steps;
+    }
+    else
+    {
+        actual_position += (stepper_position_t)steps;
+        electrical_phase += phase;
+        substep_reached += (uint16_t)steps;
+    }
+    substep_reached &= SUBSTEP_MASK;
+    PositionCompareJump(steps, reverse);
+}
+
+#if (STEP_DIR_INTERPOLATE == true)
+/* STEP/DIR mode with interpolation: every pulse adds step_dir_ratio sub-steps to the distance left, and the motor
+ * covers that distance at the speed that ends it when the next pulse is expected, one pulse period later.
+ * The coarse steps are spread over the sine table entries, and the motor never passes the commanded position.
+ * Beyond two pulses of lag the input is faster than one sub-step per tick, and the excess is applied at once. */
+static void StepDirAdvance(void)
+{
+    int16_t  pulses = StepDir_StepsGet();
+    bool     reverse = (pulses < 0);
+    uint32_t steps = (uint32_t)(reverse ? -(int32_t)pulses : pulses) * step_dir_ratio;
+    uint32_t lag_max = (uint32_t)step_dir_ratio << 17;
+    uint32_t distance;
+
+    if(step_dir_ticks < UINT16_MAX)
+        step_dir_ticks++;
+
+    if(steps != 0)
+    {
+        uint16_t period = (step_dir_ticks < STEP_DIR_PERIOD_MAX) ? step_dir_ticks : STEP_DIR_PERIOD_MAX;
+
+        if(steps > (lag_max >> 16))
+        {
+            StepDirJump(steps - (lag_max >> 16), reverse);
+            steps = lag_max >> 16;
+        }
+        step_dir_lag += reverse ? -(int32_t)(steps << 16) : (int32_t)(steps << 16);
+
+        distance = (step_dir_lag < 0) ? (uint32_t)(-step_dir_lag) : (uint32_t)step_dir_lag;
+        if(distance > lag_max)
+        {
+            uint32_t excess = (distance - lag_max + 0xFFFF) >> 16;
+
+            StepDirJump(excess, step_dir_lag < 0);
+            step_dir_lag += (step_dir_lag < 0) ? (int32_t)(excess << 16) : -(int32_t)(excess << 16);
+            distance -= excess << 16;
+        }
+
+        /* The only division, once per pulse */
+        distance /= period;
+        step_dir_speed = (distance > UINT16_MAX) ? UINT16_MAX : (uint16_t)distance;
+        step_dir_ticks = 0;
+    }
+
+    distance = (step_dir_lag < 0) ? (uint32_t)(-step_dir_lag) : (uint32_t)step_dir_lag;
+    actual_speed = (distance < step_dir_speed) ? (uint16_t)distance : step_dir_speed;
+    if(actual_speed != 0)
+    {
+        direction = (step_dir_lag < 0);
+        step_dir_lag += direction ? (int32_t)actual_speed : -(int32_t)actual_speed;
+    }
+    MotorAdvance(UINT8_MAX);
+}
+#else
+/* STEP/DIR mode: the pulses counted by the hardware since the previous tick move the electrical angle directly,
+ * step_dir_ratio sub-steps each, in the direction latched from the DIR input at each edge. A tick can move more than
+ * one sub-step, StepDirJump runs the position compare for all of them. */
+static void StepDirAdvance(void)
+{
+    int16_t  pulses = StepDir_StepsGet();
+    uint32_t steps = (uint32_t)((pulses < 0) ? -(int32_t)pulses : pulses) * step_dir_ratio;
+
+    if(steps != 0)
+    {
+        direction = (pulses < 0);
+        StepDirJump(steps, direction);
+    }
+
+    /* Speed of the BEMF compensation, averaged over about 16 ticks */
+    step_dir_rate = step_dir_rate - (step_dir_rate >> 4) + (((steps > UINT16_MAX) ? UINT16_MAX : steps) << 12);
+    actual_speed = (step_dir_rate > UINT16_MAX) ? UINT16_MAX : (uint16_t)step_dir_rate;
+    DriveApply(0, direction);
+}
+#endif /* STEP_DIR_INTERPOLATE */
+
+#if (ENCODER_FEEDBACK == true)
+/* Takes the encoder counts since the previous tick into the measured position. A count is SUBSTEPS_PER_REV /
+ * ENCODER_COUNTS_PER_REV sub-steps, carried by the remainder. Beyond the limit of the following error the flag is
+ * raised and the callback gets the position, once until Stepper_FollowErrorReset: a missed step is seen within the tick. */
+static void FollowErrorCheck(void)
+{
+    uint16_t count = Encoder_CountGet();
+    int32_t  error;
+
+    if(count != encoder_count)
+    {
+        encoder_fraction += (int32_t)(int16_t)(count - encoder_count) * SUBSTEPS_PER_REV;
+        encoder_count = count;
+        while(encoder_fraction >= ENCODER_COUNTS_PER_REV)
+        {
+            encoder_fraction -= ENCODER_COUNTS_PER_REV;
+            encoder_position++;
+        }
+        while(encoder_fraction < 0)
+        {
+            encoder_fraction += ENCODER_COUNTS_PER_REV;
+            encoder_position--;
+        }
+    }
+    error = actual_position - encoder_position;
+    if(((error > follow_limit) || (error < -follow_limit)) && (follow_error_flag == false))
+    {
+        follow_error_flag = true;
+        if(follow_error_callback != NULL)
+            follow_error_callback(actual_position);
+    }
+}
+#endif /* ENCODER_FEEDBACK */
+
+/* Places the measured position on the position, rounded to the nearest sub-step */
+static void EncoderAlign(void)
+{
+    encoder_count = Encoder_CountGet();
+    encoder_position = actual_position;
+    encoder_fraction = ENCODER_COUNTS_PER_REV / 2;
+    follow_error_flag = false;
+}
+
+#if (ENCODER_FEEDBACK == true)
+/* Holds the commanded angle with the rated current until the rotor has settled on it, then aligns the encoder on the
+ * position and closes the loop */
+static void ClosedLoopAlign(void)
+{
+    if(--closed_loop_align == 0)
+    {
+        EncoderAlign();
+        closed_loop = true;
+        return;
+    }
+    AmplitudeSet(amplitude);
+    StepAdvance(electrical_phase, 0, direction);
+}
+#endif /* ENCODER_FEEDBACK */
+
+/* Starts the quick stop requested since the previous tick: the velocity mode decelerates to standstill */
+static void QuickStopStart(void)
+{
+    quick_stop_request = false;
+    if(segment_active || velocity_mode)
+    {
+        /* Take over from the movement in progress at its speed, in its direction */
+        segment_active = false;
+        speed_fraction = 0;
+        velocity_mode = true;
+        velocity_speed = 0;
+        velocity_direction = direction;
+        velocity_deceleration = QUICK_STOP_DEC;
+        quick_stop_active = true;
+        stop_latency = (uint16_t)((uint16_t)(tick_count - quick_stop_ticks) * TICK_CLOCKS + TCE0_CounterGet() - quick_stop_clock);
+    }
+    else if(step_dir_mode)
+    {
+        /* The inputs are no longer followed, the motor stops on the sub-step reached in this tick */
+        step_dir_stop = true;
+        quick_stop_active = true;
+        stop_latency = (uint16_t)((uint16_t)(tick_count - quick_stop_ticks) * TICK_CLOCKS + TCE0_CounterGet() - quick_stop_clock);
+    }
+    else if(stop_callback != NULL)
+    {
+        /* Already at standstill */
+        stop_callback(actual_position);
+    }
+    queue_tail = queue_head;
+}
+
+/* Sub-steps the tick can move: up to the end of the segment, and of the next ones joined to it in the same direction.
+ * A motor faster than one sub-step per tick does not pass the end of the last one. */
+static inline uint8_t SegmentStepsMax(void)
+{
+    uint32_t steps = steps_to_go;
+    uint8_t  k = queue_head;
+
+    while(steps < UINT8_MAX)
+    {
+        k = (k + 1) & QUEUE_MASK;
+        if((k == queue_tail) || (queue[k].direction != direction))
+            return (uint8_t)steps;
+        steps += queue[k].steps;
+    }
+    return UINT8_MAX;
+}
+
+/* Counts the sub-steps of the tick against the segment in progress. The ones beyond its end belong to the next segment,
+ * which is blended in without stopping. */
+static inline void SegmentAdvance(uint8_t steps)
+{
+    while(steps >= steps_to_go)
+    {
+        steps -= (uint8_t)steps_to_go;
+        steps_to_go = 0;
+        segment_active = false;
+        queue_head = (queue_head + 1) & QUEUE_MASK;
+
+        /* Blend into the next segment without stopping */
+        if(SegmentLoad() == false)
+        {
+            MotionEnd();
+            return;
+        }
+    }
+    steps_to_go -= steps;
+}
+
+/* Above one sub-step per tick, the ticks advance several sub-steps and the deceleration starts up to a tick early
+ * (StopSteps): the speed is held until it is the one that stops on the end of the segment,
+ * speed^2 >= exit_speed^2 + 2 * 65536 * deceleration * steps_to_go, compared in units of 256 to stay in 32 bits. */
+static inline bool DecelerationDue(const stepper_segment_t *segment)
+{
+    uint32_t speed = actual_speed >> 8;
+    uint32_t exit_speed = segment->exit_speed >> 8;
+
+    return speed * speed >= exit_speed * exit_speed + 2 * (uint32_t)segment->deceleration * steps_to_go;
+}
+
+/* Runs the speed profile and advances the motor, so the movement timing does not depend on the main loop */
+static void TickUpdate(void)
+{
+    stepper_segment_t *segment;
+
+    tick_count++;
+
+    /* The compare pulses last one tick */
+    if(compare_pulse)
+    {
+        POSITION_COMPARE_PORT.OUTCLR = POSITION_COMPARE_PIN_bm;
+        compare_pulse = false;
+    }
+
+#if (ENCODER_FEEDBACK == true)
+    FollowErrorCheck();
+#endif
+
+    if(quick_stop_request)
+        QuickStopStart();
+
+    if(vbus_updated)
+    {
+        VBusUpdate();
+        if((segment_active == false) && (velocity_mode == false))
+            AmplitudeSet(amplitude);
+    }
+
+#if (ENCODER_FEEDBACK == true)
+    if(closed_loop_align != 0)
+    {
+        ClosedLoopAlign();
+        return;
+    }
+#endif
+
+    if(step_dir_mode)
+    {
+        if(step_dir_stop)
+        {
+            step_dir_mode = false;
+            step_dir_stop = false;
+            CompareSync();
+            MotionEnd();
+        }
+        else
+        {
+            StepDirAdvance();
+        }
+        return;
+    }
+
+    if(velocity_mode)
+    {
+        VelocityUpdate();
+        MotorAdvance(UINT8_MAX);
+        if((actual_speed == 0) && (velocity_speed == 0))
+        {
+            velocity_mode = false;
+            MotionEnd();
+        }
+        return;
+    }
+
+    if(segment_active == false)
+    {
+        if(SegmentLoad() == false)
+        {
+#if (ENCODER_FEEDBACK == true)
+            /* At standstill the closed loop holds the position with the current it needs */
+            if(closed_loop)
+                MotorAdvance(UINT8_MAX);
+#endif
+            return;
+        }
+    }
+    segment = &queue[queue_head];
+
+    /* Verifying the speed profile: acceleration, deceleration and constant speed */
+    if(segment->jerk != 0)
+    {
+        if(steps_to_go > segment->steps_until_stop)
+            SCurveUpdate(segment->peak_speed, segment->acceleration, segment->jerk);
+        else
+            SCurveUpdate((segment->exit_speed > segment->deceleration) ? segment->exit_speed : segment->deceleration, segment->deceleration, segment->jerk);
+    }
+    else if(steps_to_go > segment->steps_until_stop)
+    {
+        if(actual_speed + segment->acceleration < segment->speed_limit)
+        {
+            actual_speed += segment->acceleration;
+        }
+        else if(actual_speed < segment->speed_limit) actual_speed++;
+        else if(actual_speed > segment->speed_limit)
+        {
+            /* Speed limit lowered by Stepper_SetTarget */
+            actual_speed = (actual_speed > segment->speed_limit + segment->deceleration) ? (actual_speed - segment->deceleration) : segment->speed_limit;
+        }
+    }
+    else
+    {
+        /* Decelerate down to the speed at which the next segment takes over */
+        uint32_t floor_speed = (segment->exit_speed > 1) ? segment->exit_speed : 1;
+
+        if((actual_speed > UINT16_MAX) && (DecelerationDue(segment) == false))
+        {
+            /* Still slow enough to stop on the end of the segment: speed held */
+        }
+        else if(actual_speed > floor_speed + segment->deceleration)
+        {
+            actual_speed -= segment->deceleration;
+        }
+        else if(actual_speed > floor_speed) actual_speed--;
+    }
+    SegmentAdvance(MotorAdvance(SegmentStepsMax()));
+}
+
+/* This function is registered as a callback and must be called once in 50 us.
+ * The TCE0 counter at the end is the time taken since the start of the PWM period, interrupt entry included. */
+void Stepper_TimeTick(void)
+{
+    uint16_t clocks;
+
+    TickUpdate();
+
+    /* The last coil values of the tick, once, so the PWM update never takes a half written set */
+    if(coil_write)
+    {
+        coil_write = false;
+        TCE0_CompareAllChannelsBufferedSet(coil_channel[0], coil_channel[1], coil_channel[2], coil_channel[3]);
+    }
+
+    clocks = TCE0_CounterGet();
+    if(TCE0_Interrupts_FlagsGet() & TCE_OVF_bm)
+    {
+        /* Overrun: the next period has already started */
+        clocks += TICK_CLOCKS;
+    }
+    if(clocks > tick_clocks_max)
+        tick_clocks_max = clocks;
+}
+
+
+void Stepper_Init(void)
+{
+    queue_head = 0;
+    queue_tail = 0;
+    segment_active = false;
+    velocity_mode = false;
+    velocity_speed = 0;
+    step_dir_mode = false;
+    step_dir_stop = false;
+    quick_stop_request = false;
+    quick_stop_active = false;
+    stop_latency = 0;
+    stop_callback = NULL;
+    idle_callback = NULL;
+    compare_list = NULL;
+    compare_count = 0;
+    compare_index = 0;
+    compare_interval = 0;
+    compare_pulse = false;
+    compare_pulses = 0;
+    follow_limit = FOLLOW_ERROR_LIMIT;
+    follow_error_callback = NULL;
+    closed_loop = false;
+    closed_loop_align = 0;
+    tick_count = 0;
+    tick_clocks_max = 0;
+    actual_position = 0;
+    actual_speed = 0;
+    EncoderAlign();
+    amplitude = AMP_TO_U16(0.0);
+    supply_mv = 0;
+    vbus_updated = false;
+    vbus_inverse = 0;
+    vbus_shift = 0;
+    profile = STEPPER_PROFILE_TRAPEZOID;
+    profile_jerk = 0;
+    electrical_phase = 0;
+    substep_reached = 0;
+    last_angle = 0;
+    coil_write = false;
+    angle_width = STEPPER_RESOLUTION_MAX / STEPPER_RESOLUTION_DEFAULT;
+    angle_width_next = angle_width;
+    /* Enable hardware scaling accelerator after initialization */
+    TCE0_ScaleEnable(true);
+    TCE0_AmplitudeSet(DRIVE_ZERO);
+    TCE0_CompareAllChannelsBufferedSet(DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO);
+}
+
+/* Integer square root, used only by the planner */
+static uint16_t SqrtU32(uint32_t x)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while(bit > x)
+        bit >>= 2;
+
+    while(bit != 0)
+    {
+        if(x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t)root;
+}
+
+/* Square root of a squared speed. Above 32 bits the lowest bits are dropped, the root is then short by less than
+ * one part in 2^15, which only lowers a planned speed. */
+static uint32_t SqrtU64(uint64_t x)
+{
+    uint8_t shift = 0;
+
+    while(x > UINT32_MAX)
+    {
+        x >>= 2;
+        shift++;
+    }
+    return (uint32_t)SqrtU32((uint32_t)x) << shift;
+}
+
+/* Squared speed reached after changing speed with the given rate over a number of sub-steps,
+ * up to the square of the highest speed */
+static uint64_t SqSpeedAfter(uint64_t sq_speed, uint16_t rate, uint32_t steps)
+{
+    uint64_t gain = (uint64_t)rate * steps;
+
+    if(gain > (SQ_SPEED_MAX >> 17))
+        return SQ_SPEED_MAX;
+    sq_speed += gain << 17;
+    return (sq_speed > SQ_SPEED_MAX) ? SQ_SPEED_MAX : sq_speed;
+}
+
+/* Sub-steps needed by the S-curve to change speed between two values, starting and ending with zero acceleration */
+static uint32_t SCurveSteps(uint32_t speed_from, uint32_t speed_to, uint16_t rate, uint16_t jerk)
+{
+    uint32_t dv = (speed_to > speed_from) ? (speed_to - speed_from) : (speed_from - speed_to);
+    uint32_t ramp_ticks = ((uint32_t)rate << 8) / jerk;     /* Ticks to ramp the acceleration from zero to rate */
+    uint32_t ticks;
+
+    if(dv >= (uint32_t)rate * ramp_ticks)
+    {
+        /* The acceleration reaches rate: jerk, constant acceleration, jerk */
+        ticks = ramp_ticks + dv / rate;
+    }
+    else
+    {
+        /* The acceleration peaks below rate: jerk up, jerk down */
+        ticks = 2 * (uint32_t)SqrtU32((dv << 8) / jerk);
+    }
+    /* The average speed over a symmetric S-curve is the mean of the two speeds */
+    return (uint32_t)(((uint64_t)(speed_from + speed_to) * ticks) / (2 * 65536));
+}
+
+/* Highest speed the S-curve can change to from a given speed within a number of sub-steps */
+static uint32_t SCurveReach(uint32_t speed_from, uint16_t rate, uint16_t jerk, uint32_t steps)
+{
+    uint32_t low = speed_from;
+    uint32_t high = SPEED_MAX;
+
+    if(SCurveSteps(speed_from, high, rate, jerk) <= steps)
+        return high;
+
+    while(high - low > 1)
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if(SCurveSteps(speed_from, middle, rate, jerk) <= steps)
+            low = middle;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/* Squared speed reachable within a segment, for either profile. The rate is the acceleration or the deceleration. */
+static uint64_t SqSpeedReach(const stepper_segment_t *segment, uint64_t sq_speed, uint16_t rate)
+{
+    uint32_t speed;
+
+    if(segment->jerk == 0)
+        return SqSpeedAfter(sq_speed, rate, segment->steps);
+
+    speed = SCurveReach(SqrtU64(sq_speed), rate, segment->jerk, segment->steps);
+    return (uint64_t)speed * speed;
+}
+
+/* S-curve only: highest speed that still leaves room to reach the exit speed, and the matching stop distance */
+static uint32_t SCurveStopSteps(stepper_segment_t *segment, uint32_t entry_speed, uint32_t exit_speed)
+{
+    uint32_t low = (entry_speed > exit_speed) ? entry_speed : exit_speed;
+    uint32_t high = segment->speed_limit;
+
+    if(low > high)
+        low = high;
+
+    if(SCurveSteps(entry_speed, high, segment->acceleration, segment->jerk) + SCurveSteps(high, exit_speed, segment->deceleration, segment->jerk) <= segment->steps)
+    {
+        low = high;
+    }
+    while(high - low > 1)
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if(SCurveSteps(entry_speed, middle, segment->acceleration, segment->jerk) + SCurveSteps(middle, exit_speed, segment->deceleration, segment->jerk) <= segment->steps)
+            low = middle;
+        else
+            high = middle;
+    }
+    segment->peak_speed = low;
+    return SCurveSteps(low, exit_speed, segment->deceleration, segment->jerk);
+}
+
+/* Number of sub-steps before the end of the segment at which the deceleration must start */
+static uint32_t StopSteps(const stepper_segment_t *segment, uint64_t sq_entry, uint64_t sq_exit)
+{
+    uint32_t acc = segment->acceleration;
+    uint32_t dec = segment->deceleration;
+    uint64_t sq_speed_limit = (uint64_t)segment->speed_limit * segment->speed_limit;
+    uint64_t sq_speed_top = sq_speed_limit;
+    uint64_t ramp_steps = 0;
+
+    /* Sub-steps to reach the speed limit and to leave it. A longer movement has a trapezoidal profile: acceleration,
+     * constant speed, deceleration; the products below would not fit in 64 bits for it. */
+    if(sq_speed_limit > sq_entry)
+        ramp_steps += (sq_speed_limit - sq_entry) / (2 * 65536 * (uint64_t)acc);
+    if(sq_speed_limit > sq_exit)
+        ramp_steps += (sq_speed_limit - sq_exit) / (2 * 65536 * (uint64_t)dec);
+    if(segment->steps < ramp_steps)
+    {
+        /* Otherwise triangular profile: acceleration, deceleration */
+        sq_speed_top = (2 * (uint64_t)acc * dec * segment->steps * 65536 + dec * sq_entry + acc * sq_exit) / (acc + dec);
+        if(sq_speed_top > sq_speed_limit)
+            sq_speed_top = sq_speed_limit;
+    }
+    if(sq_speed_top <= sq_exit)
+        return 0;
+
+    /* Above one sub-step per tick, the deceleration starts a tick of sub-steps early, TickUpdate holds the speed until due */
+    return (uint32_t)((sq_speed_top - sq_exit) / (2 * 65536 * (uint64_t)dec)) + ((segment->speed_limit - 1) >> 16);
+}
+
+/* Look-ahead planner. Computes the exit speed of every queued segment so that consecutive
+ * segments in the same direction are joined without stopping. The last segment always ends at zero speed. */
+static void PlanQueue(void)
+{
+    uint64_t sq_exit[STEPPER_QUEUE_SIZE];
+    uint32_t until_stop[STEPPER_QUEUE_SIZE];
+    uint32_t exit_speed[STEPPER_QUEUE_SIZE];
+    uint32_t peak_speed[STEPPER_QUEUE_SIZE];
+    uint8_t  head, count, k;
+    uint32_t entry_speed;
+    bool     done = false;
+
+    while(done == false)
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            head = queue_head;
+            count = (queue_tail - head) & QUEUE_MASK;
+            entry_speed = segment_active ? queue[head].entry_speed : actual_speed;
+        }
+        if(count == 0)
+            return;
+
+        /* Backward pass: each junction speed must allow the following segment to slow down in time */
+        sq_exit[count - 1] = 0;
+        for(k = count - 1; k > 0; k--)
+        {
+            const stepper_segment_t *next = &queue[(head + k) & QUEUE_MASK];
+            const stepper_segment_t *prev = &queue[(head + k - 1) & QUEUE_MASK];
+
+            if(next->direction != prev->direction)
+            {
+                sq_exit[k - 1] = 0;
+            }
+            else
+            {
+                uint32_t junction = (prev->speed_limit < next->speed_limit) ? prev->speed_limit : next->speed_limit;
+                uint64_t sq_junction = (uint64_t)junction * junction;
+                uint64_t sq_reach = SqSpeedReach(next, sq_exit[k], next->deceleration);
+
+                sq_exit[k - 1] = (sq_junction < sq_reach) ? sq_junction : sq_reach;
+            }
+        }
+
+        /* Forward pass: each exit speed must be reachable from the entry speed */
+        uint64_t sq_entry = (uint64_t)entry_speed * entry_speed;
+        for(k = 0; k < count; k++)
+        {
+            stepper_segment_t segment = queue[(head + k) & QUEUE_MASK];
+            uint64_t sq_reach = SqSpeedReach(&segment, sq_entry, segment.acceleration);
+
+            if(sq_exit[k] > sq_reach)
+                sq_exit[k] = sq_reach;
+            exit_speed[k] = SqrtU64(sq_exit[k]);
+            if(segment.jerk == 0)
+                until_stop[k] = StopSteps(&segment, sq_entry, sq_exit[k]);
+            else
+                until_stop[k] = SCurveStopSteps(&segment, SqrtU64(sq_entry), exit_speed[k]);
+            peak_speed[k] = segment.peak_speed;
+            sq_entry = sq_exit[k];
+        }
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            /* If the tick moved to another segment meanwhile, the plan starts from a stale entry speed */
+            if(queue_head == head)
+            {
+                for(k = 0; k < count; k++)
+                {
+                    queue[(head + k) & QUEUE_MASK].exit_speed = exit_speed[k];
+                    queue[(head + k) & QUEUE_MASK].steps_until_stop = until_stop[k];
+                    queue[(head + k) & QUEUE_MASK].peak_speed = peak_speed[k];
+                }
+                done = true;
+            }
+        }
+    }
+}
+
+void Stepper_VBusSet(uint16_t vbus_mv)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        supply_mv = vbus_mv;
+        vbus_updated = true;
+    }
+}
+
+/* Writes a movement at the tail of the queue. The slot is not visible to the tick until queue_tail is advanced. */
+static void SegmentQueue(stepper_position_t steps, uint16_t acc, uint16_t dec, uint32_t speed)
+{
+    uint8_t tail = queue_tail;
+    stepper_segment_t *segment = &queue[tail];
+
+    if(speed > Stepper_SpeedMaxGet())
+        speed = Stepper_SpeedMaxGet();
+
+    if(steps < 0)
+    {
+        segment->direction = true;
+        segment->steps = (uint32_t)(0 - steps);
+    }
+    else
+    {
+        segment->direction = false;
+        segment->steps = (uint32_t)steps;
+    }
+    segment->acceleration = acc;
+    segment->deceleration = dec;
+    segment->speed_limit = speed;
+    segment->entry_speed = 0;
+    segment->exit_speed = 0;
+    if((profile == STEPPER_PROFILE_SCURVE) && (profile_jerk != 0))
+    {
+        segment->jerk = profile_jerk;
+        segment->steps_until_stop = SCurveStopSteps(segment, 0, 0);
+    }
+    else
+    {
+        segment->jerk = 0;
+        segment->peak_speed = speed;
+        segment->steps_until_stop = StopSteps(segment, 0, 0);
+    }
+
+    queue_tail = (tail + 1) & QUEUE_MASK;
+}
+
+/* Sub-steps needed to stop from the actual speed with the deceleration of the segment in progress.
+ * At least one, the tick ends a segment on a sub-step. */
+static uint32_t StopDistance(const stepper_segment_t *segment)
+{
+    uint32_t stop_steps;
+
+    if(segment->jerk != 0)
+    {
+        /* While accelerating, the speed still grows by ramp_dv until the acceleration is back to zero */
+        uint32_t peak = actual_speed + (accel_up ? (ramp_dv >> 8) : 0);
+
+        stop_steps = SCurveSteps(peak, 0, segment->deceleration, segment->jerk);
+    }
+    else if(actual_speed <= UINT16_MAX)
+    {
+        stop_steps = (actual_speed * actual_speed) / (2 * 65536 * (uint32_t)segment->deceleration);
+    }
+    else
+    {
+        /* Above one sub-step per tick, only reached at the coarse resolutions */
+        stop_steps = (uint32_t)(((uint64_t)actual_speed * actual_speed) / (2 * 65536 * (uint32_t)segment->deceleration));
+    }
+    return (stop_steps == 0) ? 1 : stop_steps;
+}
+
+bool Stepper_MoveStart(stepper_position_t steps, uint16_t acc, uint16_t dec, uint32_t speed, uint16_t vbus_mv)
+{
+    if((((queue_tail + 1) & QUEUE_MASK) == queue_head) || velocity_mode || step_dir_mode)
+        return false;
+
+    Stepper_VBusSet(vbus_mv);
+
+    if(steps == 0)
+        return true;
+
+    SegmentQueue(steps, acc, dec, speed);
+
+    PlanQueue();
+    return true;
+}
+
+bool Stepper_SetTarget(stepper_position_t target, uint16_t acc, uint16_t dec, uint32_t speed, uint16_t vbus_mv)
+{
+    stepper_position_t back = 0;
+
+    if(velocity_mode || step_dir_mode)
+        return false;
+
+    if(speed > Stepper_SpeedMaxGet())
+        speed = Stepper_SpeedMaxGet();
+
+    Stepper_VBusSet(vbus_mv);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        stepper_position_t remaining = target - actual_position;
+
+        if(segment_active)
+        {
+            stepper_segment_t *segment = &queue[queue_head];
+            uint32_t stop_steps;
+            uint32_t distance = direction ? (uint32_t)(0 - remaining) : (uint32_t)remaining;
+            bool     ahead = direction ? (remaining < 0) : (remaining > 0);
+
+            /* The queued movements are dropped, the one in progress continues from its actual speed with the new parameters */
+            queue_tail = (queue_head + 1) & QUEUE_MASK;
+            segment->acceleration = acc;
+            segment->deceleration = dec;
+            segment->speed_limit = speed;
+            segment->entry_speed = actual_speed;
+            segment->exit_speed = 0;
+            stop_steps = StopDistance(segment);
+
+            if(ahead && (distance >= stop_steps))
+            {
+                /* Still reachable in the same direction: the movement is stretched or shortened to the target.
+                 * Until the planner below updates it, the deceleration starts at the stop distance. */
+                segment->steps = distance;
+                segment->steps_until_stop = stop_steps;
+            }
+            else
+            {
+                /* Behind the motor, or too close to stop on it: stop as soon as possible and come back */
+                segment->steps = stop_steps;
+                segment->steps_until_stop = stop_steps;
+                back = direction ? (remaining + (stepper_position_t)stop_steps) : (remaining - (stepper_position_t)stop_steps);
+            }
+            steps_to_go = segment->steps;
+        }
+        else
+        {
+            /* At standstill, a new movement */
+            queue_tail = queue_head;
+            back = remaining;
+        }
+    }
+
+    if(back != 0)
+        SegmentQueue(back, acc, dec, speed);
+
+    PlanQueue();
+    return true;
+}
+
+void Stepper_VelocitySet(bool new_direction, uint32_t speed, uint16_t acc, uint16_t dec, uint16_t vbus_mv)
+{
+    Stepper_VBusSet(vbus_mv);
+    if(speed > Stepper_SpeedMaxGet())
+        speed = Stepper_SpeedMaxGet();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(quick_stop_request || quick_stop_active || step_dir_mode)
+            return;
+
+        velocity_speed = speed;
+        velocity_direction = new_direction;
+        velocity_acceleration = acc;
+        velocity_deceleration = dec;
+        if(velocity_mode == false)
+        {
+            if(segment_active)
+            {
+                /* Take over from the movement in progress at its speed, the queued movements are dropped */
+                segment_active = false;
+                speed_fraction = 0;
+            }
+            else if(speed == 0)
+            {
+                /* Already at standstill */
+                return;
+            }
+            else
+            {
+                /* Starting from standstill */
+                AmplitudeSet(amplitude);
+                actual_speed = 0;
+                direction = new_direction;
+            }
+            queue_tail = queue_head;
+            velocity_mode = true;
+        }
+    }
+}
+
+bool Stepper_StepDirStart(uint8_t ratio, uint16_t vbus_mv)
+{
+    if(ratio == 0)
+        return false;
+
+    Stepper_VBusSet(vbus_mv);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(Stepper_IsBusy() || quick_stop_request)
+            return false;
+
+        /* The pulses counted until now are not followed */
+        StepDir_StepsGet();
+        step_dir_ratio = ratio;
+        step_dir_rate = 0;
+        step_dir_lag = 0;
+        step_dir_ticks = UINT16_MAX;
+        step_dir_speed = 0;
+        step_dir_stop = false;
+        actual_speed = 0;
+        AmplitudeSet(amplitude);
+        CompareSync();
+        step_dir_mode = true;
+    }
+    return true;
+}
+
+void Stepper_Stop(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(step_dir_mode)
+        {
+            /* Stops on the sub-step reached, the next pulses are ignored */
+            step_dir_stop = true;
+        }
+        else if(velocity_mode)
+        {
+            /* Decelerates with the velocity mode deceleration */
+            velocity_speed = 0;
+        }
+        else if(segment_active)
+        {
+            stepper_segment_t *segment = &queue[queue_head];
+            uint32_t stop_steps = StopDistance(segment);
+
+            /* The queued movements are dropped, the one in progress is shortened to its stop distance */
+            queue_tail = (queue_head + 1) & QUEUE_MASK;
+            if(stop_steps < steps_to_go)
+                steps_to_go = stop_steps;
+            segment->exit_speed = 0;
+            segment->steps_until_stop = steps_to_go;
+        }
+        else
+        {
+            queue_tail = queue_head;
+        }
+    }
+}
+
+void Stepper_QuickStop(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(quick_stop_request == false)
+        {
+            quick_stop_ticks = tick_count;
+            quick_stop_clock = TCE0_CounterGet();
+            if(TCE0_Interrupts_FlagsGet() & TCE_OVF_bm)
+            {
+                /* The counter wrapped and the tick has not run yet: the time belongs to the next period */
+                quick_stop_clock = TCE0_CounterGet();
+                quick_stop_ticks++;
+            }
+            quick_stop_request = true;
+        }
+    }
+}
+
+stepper_position_t Stepper_Abort(void)
+{
+    stepper_position_t position;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        quick_stop_request = false;
+        quick_stop_active = false;
+        velocity_mode = false;
+        step_dir_mode = false;
+        step_dir_stop = false;
+        closed_loop = false;
+        closed_loop_align = 0;
+        segment_active = false;
+        queue_tail = queue_head;
+
+        /* The zero compares are applied at the next PWM update */
+        stop_latency = TICK_CLOCKS - TCE0_CounterGet();
+        actual_speed = 0;
+        electrical_phase = (uint32_t)substep_reached * PHASE_PER_SUBSTEP;
+        angle_width = angle_width_next;
+        TCE0_CompareAllChannelsBufferedSet(DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO);
+        coil_write = false;
+        AmplitudeSet(amplitude);
+        CompareSync();
+        position = actual_position;
+    }
+    if(stop_callback != NULL)
+        stop_callback(position);
+    if(idle_callback != NULL)
+        idle_callback(position);
+    return position;
+}
+
+uint16_t Stepper_TickClocksMaxGet(void)
+{
+    uint16_t clocks;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        clocks = tick_clocks_max;
+    }
+    return clocks;
+}
+
+uint16_t Stepper_StopLatencyGet(void)
+{
+    uint16_t latency;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        latency = stop_latency;
+    }
+    return latency;
+}
+
+void Stepper_StopCallbackRegister(stepper_stop_cb_t callback)
+{
+    stop_callback = callback;
+}
+
+void Stepper_IdleCallbackRegister(stepper_stop_cb_t callback)
+{
+    idle_callback = callback;
+}
+
+/* Sets the output pin low, before the compare starts */
+static void ComparePinInit(void)
+{
+    POSITION_COMPARE_PORT.OUTCLR = POSITION_COMPARE_PIN_bm;
+    POSITION_COMPARE_PORT.DIRSET = POSITION_COMPARE_PIN_bm;
+}
+
+void Stepper_CompareListSet(const stepper_position_t *list, uint8_t count)
+{
+    ComparePinInit();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        compare_interval = 0;
+        compare_list = list;
+        compare_count = (list != NULL) ? count : 0;
+        compare_pulses = 0;
+        CompareSync();
+    }
+}
+
+void Stepper_CompareIntervalSet(stepper_position_t origin, uint16_t interval)
+{
+    ComparePinInit();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        compare_list = NULL;
+        compare_count = 0;
+        compare_origin = origin;
+        compare_interval = interval;
+        compare_pulses = 0;
+        CompareSync();
+    }
+}
+
+void Stepper_CompareDisable(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        compare_list = NULL;
+        compare_count = 0;
+        compare_interval = 0;
+    }
+}
+
+uint16_t Stepper_ComparePulsesGet(void)
+{
+    uint16_t pulses;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pulses = compare_pulses;
+    }
+    return pulses;
+}
+
+stepper_position_t Stepper_FollowErrorGet(void)
+{
+    stepper_position_t error;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        error = actual_position - encoder_position;
+    }
+    return error;
+}
+
+stepper_position_t Stepper_EncoderPositionGet(void)
+{
+    stepper_position_t position;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        position = encoder_position;
+    }
+    return position;
+}
+
+bool Stepper_FollowErrorFlagGet(void)
+{
+    return follow_error_flag;
+}
+
+void Stepper_FollowErrorLimitSet(stepper_position_t limit)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        follow_limit = limit;
+    }
+}
+
+void Stepper_FollowErrorReset(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        /* In closed loop the alignment is kept, the rotor may still be catching up */
+        if(closed_loop)
+            follow_error_flag = false;
+        else
+            EncoderAlign();
+    }
+}
+
+void Stepper_FollowErrorCallbackRegister(stepper_stop_cb_t callback)
+{
+    follow_error_callback = callback;
+}
+
+bool Stepper_ClosedLoopSet(bool enable)
+{
+    if(Stepper_IsBusy() || (enable && (ENCODER_FEEDBACK != true)))
+        return false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(enable)
+        {
+            closed_loop = false;
+            closed_loop_align = CLOSED_LOOP_ALIGN_TICKS;
+        }
+        else if(closed_loop)
+        {
+            /* Back to the open loop drive at standstill: held or released as after a movement */
+            closed_loop = false;
+            MotorStop();
+        }
+    }
+    return true;
+}
+
+bool Stepper_ClosedLoopIsActive(void)
+{
+    return closed_loop;
+}
+
+void Stepper_ProfileSet(stepper_profile_t new_profile, uint16_t jerk)
+{
+    profile = new_profile;
+    profile_jerk = jerk;
+}
+
+bool Stepper_ResolutionSet(uint16_t new_resolution)
+{
+    uint16_t width;
+    uint32_t speed_max;
+    bool     valid = true;
+    uint8_t  k;
+
+    /* Powers of two from 1 to STEPPER_RESOLUTION_MAX */
+    if((new_resolution == 0) || (new_resolution > STEPPER_RESOLUTION_MAX) || ((new_resolution & (new_resolution - 1)) != 0))
+        return false;
+
+    width = STEPPER_RESOLUTION_MAX / new_resolution;
+    speed_max = SPEED_PER_WIDTH * width;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        /* A finer resolution is slower: not while the motor, the velocity mode or a queued movement is faster */
+        if((actual_speed > speed_max) || (velocity_mode && (velocity_speed > speed_max)))
+            valid = false;
+        for(k = queue_head; k != queue_tail; k = (k + 1) & QUEUE_MASK)
+        {
+            if(queue[k].speed_limit > speed_max)
+                valid = false;
+        }
+        if(valid)
+        {
+            angle_width_next = width;
+            /* Between movements the new resolution is used from the next step on */
+            if((queue_head == queue_tail) && (velocity_mode == false) && (step_dir_mode == false))
+                angle_width = angle_width_next;
+        }
+    }
+    return valid;
+}
+
+uint16_t Stepper_ResolutionGet(void)
+{
+    return STEPPER_RESOLUTION_MAX / angle_width_next;
+}
+
+uint32_t Stepper_SpeedMaxGet(void)
+{
+    return SPEED_PER_WIDTH * angle_width_next;
+}
+
+bool Stepper_IsBusy(void)
+{
+    return (queue_head != queue_tail) || velocity_mode || step_dir_mode || (closed_loop_align != 0);
+}
+
+bool Stepper_QueueIsFull(void)
+{
+    return (((queue_tail + 1) & QUEUE_MASK) == queue_head);
+}
+
+stepper_position_t Stepper_GetPosition(void)
+{
+    stepper_position_t position;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        position = actual_position;
+    }
+    return position;
+}
+
+void Stepper_PositionSet(stepper_position_t position)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        /* The measured position moves with it, the following error is kept */
+        encoder_position += position - actual_position;
+        actual_position = position;
+        CompareSync();
+    }
+}
+
+#if (ENCODER_FEEDBACK == true)
+/* Waits for a number of ticks, used only by Stepper_Move */
+static void TicksWait(uint16_t ticks)
+{
+    uint16_t start;
+    uint16_t now;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        start = tick_count;
+    }
+    do
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            now = tick_count;
+        }
+    } while((uint16_t)(now - start) < ticks);
+}
+
+#if (MOVE_VERIFY == true)
+/* Reads the encoder once the rotor has settled and corrects an error larger than the tolerance, used only by Stepper_Move */
+static void MoveVerify(uint16_t acceleration, uint16_t deceleration, uint16_t vbus_mv)
+{
+    stepper_position_t error;
+    uint8_t            tries = 0;
+
+    while(1)
+    {
+        TicksWait(MOVE_VERIFY_SETTLE);
+        error = Stepper_FollowErrorGet();
+        if(((error <= MOVE_VERIFY_TOLERANCE) && (error >= -MOVE_VERIFY_TOLERANCE)) || closed_loop || (tries == MOVE_CORRECTION_TRIES))
+            break;
+        tries++;
+
+        /* The position and the electrical angle are placed on the rotor, the encoder stays, and the rotor is moved
+         * slowly by the error. With the coils released the rotor rests away from the commanded angle, the field
+         * must start from the rotor or it pulls the rotor back to the commanded angle before the correction. */
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            actual_position -= error;
+            electrical_phase -= (uint32_t)error * PHASE_PER_SUBSTEP;
+            substep_reached = (uint16_t)(substep_reached - (uint16_t)error) & SUBSTEP_MASK;
+            CompareSync();
+        }
+        Stepper_MoveStart(error, acceleration, deceleration, MOVE_CORRECTION_SPEED, vbus_mv);
+        while(Stepper_IsBusy());
+    }
+}
+#endif /* MOVE_VERIFY */
+#endif /* ENCODER_FEEDBACK */
+
+stepper_position_t Stepper_Move(stepper_position_t initial_position, stepper_position_t steps, uint16_t acceleration, uint16_t deceleration, uint32_t speed_limit, uint16_t vbus_mv, stepper_position_t *measured)
+{
+    stepper_position_t position;
+
+    while(Stepper_IsBusy());
+
+    Stepper_PositionSet(initial_position);
+    Stepper_MoveStart(steps, acceleration, deceleration, speed_limit, vbus_mv);
+
+    while(Stepper_IsBusy());
+
+#if (ENCODER_FEEDBACK == true)
+#if (MOVE_VERIFY == true)
+    MoveVerify(acceleration, deceleration, vbus_mv);
+#endif /* MOVE_VERIFY */
+    position = Stepper_GetPosition();
+    if(measured != NULL)
+        *measured = Stepper_EncoderPositionGet();
+#else
+    position = Stepper_GetPosition();
+    if(measured != NULL)
+        *measured = position;
+#endif /* ENCODER_FEEDBACK */
+
+    return position;
+}
@@ -2,6 +2,7 @@
 #define STEPPER_H
 
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <avr/io.h>
 
@@ -19,6 +20,31 @@ typedef int32_t  stepper_position_t;
 #define STEP_SIZE          1.8                  /* Motor degrees / full-step */
 #define KV                 5.6                  /* Proportionality constant for BEMF compensation 1.0 ... 10.0 */
 #define RELEASE_IN_IDLE    true                 /* True: for power savings, the current through the coils is stopped. */
+#define QUICK_STOP_DEC     DEGPS_TO_U16(1.2)    /* Deceleration of Stepper_QuickStop, in the unit of the movement deceleration */
+#define FOLLOW_ERROR_LIMIT STEPS_TO_SUBSTEPS(2) /* Difference from the encoder that raises the following error flag [sub-steps], see encoder.h */
+
+/* Encoder check at the end of Stepper_Move, needs ENCODER_FEEDBACK */
+#ifndef MOVE_VERIFY                                      /* Can be set on the compiler command line, as the host tests do */
+#define MOVE_VERIFY             false                    /* True: Stepper_Move corrects an error larger than the tolerance */
+#endif
+#define MOVE_VERIFY_TOLERANCE   4                        /* Largest error left without correction [sub-steps] */
+#define MOVE_VERIFY_SETTLE      200                      /* Ticks waited before the encoder is read: 10 ms */
+#define MOVE_CORRECTION_SPEED   DEGPS_TO_U16(18)         /* Speed of the correction movements: 10 full-steps / s */
+#define MOVE_CORRECTION_TRIES   2                        /* Correction movements at most */
+
+/* Closed loop, see Stepper_ClosedLoopSet. The angles are in sub-steps, one full-step is 90 electrical degrees,
+ * so the closed loop needs the MICRO_STEP mode. */
+#define CLOSED_LOOP_LOAD_ANGLE  STEPS_TO_SUBSTEPS(0.75)  /* Largest lead of the field over the measured rotor, below 90 degrees for the encoder resolution */
+#define CLOSED_LOOP_CURRENT_MIN 0.25                     /* Current with no error, relative to I_OUT */
+#define CLOSED_LOOP_FULL_ERROR  STEPS_TO_SUBSTEPS(0.5)   /* Error from which the coils get I_OUT [sub-steps] */
+#define CLOSED_LOOP_ALIGN_TICKS 2000                     /* Ticks holding the commanded angle before the loop is closed: 100 ms */
+
+/* Output of the position compare pulses */
+#define POSITION_COMPARE_PORT   PORTD
+#define POSITION_COMPARE_PIN_bm PIN2_bm
+
+/* Number of movements that can be queued (power of two). Consecutive movements in the same direction are blended. */
+#define STEPPER_QUEUE_SIZE 8
 
 
 /* Select the desired stepping mode(only one of them) */
@@ -31,6 +57,12 @@ typedef int32_t  stepper_position_t;
 #define K_VBUS          16.0                    /* Board voltage divider ratio */
 #define ADC_VREF        3.3                     /* ADC Voltage Reference */
 
+/* VBUS in mV for the full scale of the left adjusted ADC result */
+#define VBUS_MV_SCALE   (uint32_t)(K_VBUS * ADC_VREF * 1000.0 + 0.5)
+
+/* Number of VBUS samples accumulated by the ADC for every result (ADC_SAMPNUM_ACC2_gc ... ADC_SAMPNUM_ACC1024_gc) */
+#define VBUS_SAMPNUM    ADC_SAMPNUM_ACC64_gc
+
 
 /* Sets the amplitude of the sine wave signals, and thus the scaling values of duty cycle in U.Q.1.15 format, ranging from 0 to 1.00 
  * Duty cycle scaling is done in hardware using the hardware accelerator of TCE.*/
@@ -64,36 +96,195 @@ typedef int32_t  stepper_position_t;
 #endif 
 
 
+/* Finest coil resolution, in microsteps per full-step. K_MODE must be a power of two up to this value. */
+#define STEPPER_RESOLUTION_MAX                  256
+
+/* Resolution used after Stepper_Init. K_MODE is the unit of the positions and speeds, the resolution only sets
+ * how finely the electrical angle is applied to the coils, so it can be changed without affecting the positions. */
+#define STEPPER_RESOLUTION_DEFAULT              K_MODE
+
+/* Highest speed at a coil resolution: one coil entry per tick, so every entry is applied at its exact time.
+ * Several sub-steps can pass in a tick: a coarser resolution runs faster, up to one full-step per tick at resolution 1. */
+#define STEPPER_SPEED_MAX(RESOLUTION)           ((uint32_t)65536 * K_MODE / (RESOLUTION))
+
+
 /*PWM Interrupt Interval */
 #define TICK_INTERVAL   50.0                    /* Microseconds */
+#define TICK_CLOCKS     1000                    /* TCE0 clocks per tick: PER + 1 at 20 MHz */
+
+/* Converts TCE0 clocks, as the Stepper_StopLatencyGet result, into microseconds */
+#define CLOCKS_TO_US(CLOCKS)                    ((float)(CLOCKS) * TICK_INTERVAL / TICK_CLOCKS)
 
 
 /* DEGPS - degrees per second */
 /* Converts degrees per second into 16 bit integer */
 #define DEGPS_TO_U16(dps)                       (uint16_t)(((dps) * 65536.0 * TICK_INTERVAL * K_MODE) / (STEP_SIZE * 1000000.0) + 0.5)
 
+/* Converts degrees per second into the 32 bit speed of the movements, for the speeds above one sub-step per tick */
+#define DEGPS_TO_SPEED(dps)                     (uint32_t)(((dps) * 65536.0 * TICK_INTERVAL * K_MODE) / (STEP_SIZE * 1000000.0) + 0.5)
+
 /* Converts 16 bit integer into degrees per second */
 #define U16_TO_DEGPS(u16)                       (float)((STEP_SIZE * (u16) * 1000000.0) / (65536.0 * TICK_INTERVAL * K_MODE))
 
-/* Speed limit */
-#define  SPEED_LIMIT(SPEED_U16)                 (uint16_t)(((SPEED_U16) > 32768) ? (32768) : (SPEED_U16))
+/* Converts degrees per second gained in one tick into the jerk unit: acceleration change per tick, with 8 fractional bits */
+#define DEGPS_TO_JERK(dps)                      (uint16_t)(((dps) * 65536.0 * 256.0 * TICK_INTERVAL * K_MODE) / (STEP_SIZE * 1000000.0) + 0.5)
+
+/* Speed limit of the default resolution. Stepper_SpeedMaxGet gives the one of the active resolution. */
+#define  SPEED_LIMIT(SPEED)                     (uint32_t)(((SPEED) > STEPPER_SPEED_MAX(STEPPER_RESOLUTION_DEFAULT)) ? STEPPER_SPEED_MAX(STEPPER_RESOLUTION_DEFAULT) : (SPEED))
 
 /* Converts steps into substeps */
 #define STEPS_TO_SUBSTEPS(STEPS)                (stepper_position_t)((STEPS)*(float)K_MODE)
 #define SUBSTEPS_TO_STEPS(SUBST)                ((float)(SUBST)/(float)K_MODE)
 
+/* Sub-steps per motor revolution */
+#define SUBSTEPS_PER_REV                        (int32_t)(360.0 / STEP_SIZE * K_MODE + 0.5)
+
+
+/* Speed profile of the movements */
+typedef enum
+{
+    STEPPER_PROFILE_TRAPEZOID = 0,              /* Constant acceleration */
+    STEPPER_PROFILE_SCURVE    = 1               /* Jerk-limited acceleration */
+} stepper_profile_t;
+
+
+/* Called with the position of the motor, see the callback registration functions */
+typedef void (*stepper_stop_cb_t)(stepper_position_t);
+
 
 /* Function Prototypes*/
 /* params:
     steps: if negative, then go CCW, if positive - go CW
     acceleration, deceleration: steps / s^2
-    speed: steps/s
+    speed: steps/s, DEGPS_TO_U16 or DEGPS_TO_SPEED. Lowered to Stepper_SpeedMaxGet.
     vbus: vbus expressed in mV
+    measured: if not NULL, gets the final position measured by the encoder, the returned one without ENCODER_FEEDBACK
+
+  With MOVE_VERIFY the encoder is read MOVE_VERIFY_SETTLE ticks after the movement. If the rotor is more than
+  MOVE_VERIFY_TOLERANCE away, the position is placed on the rotor and a correction movement with MOVE_CORRECTION_SPEED
+  brings it to the commanded position, up to MOVE_CORRECTION_TRIES times. Not in closed loop, which corrects itself.
 
-  returns: new position of the stepper motor
+  returns: new position of the stepper motor, as commanded
 */
-stepper_position_t Stepper_Move(stepper_position_t, stepper_position_t, uint16_t, uint16_t, uint16_t, uint16_t);
+stepper_position_t Stepper_Move(stepper_position_t, stepper_position_t, uint16_t, uint16_t, uint32_t, uint16_t, stepper_position_t *);
 void               Stepper_TimeTick(void);  /* Called periodically from interrupt context */
+
+/* Longest tick since Stepper_Init, in TCE0 clocks from the start of the PWM period to the end of Stepper_TimeTick,
+   interrupt entry included. TICK_CLOCKS or more means a tick overran its period. */
+uint16_t           Stepper_TickClocksMaxGet(void);
 void               Stepper_Init(void);
 
+/* Non-blocking interface. The movements are queued and executed by Stepper_TimeTick.
+   Stepper_MoveStart takes the same parameters as Stepper_Move, without the initial position.
+   returns: false if the movement queue is full or the velocity mode is active
+*/
+bool               Stepper_MoveStart(stepper_position_t, uint16_t, uint16_t, uint32_t, uint16_t);
+bool               Stepper_IsBusy(void);
+bool               Stepper_QueueIsFull(void);
+
+/* Moves to an absolute target, also during a movement: the queued movements are dropped and the one in progress
+   continues from its actual speed with the new parameters. If the target can no longer be reached in the same
+   direction, the motor stops with the deceleration as soon as possible and comes back to it.
+   Takes the same parameters as Stepper_MoveStart, with the target position instead of the steps.
+   returns: false if the velocity mode is active
+*/
+bool               Stepper_SetTarget(stepper_position_t, uint16_t, uint16_t, uint32_t, uint16_t);
+void               Stepper_Stop(void);      /* Decelerates to standstill with the deceleration of the movement in progress and drops the queued ones */
+
+/* Velocity mode: runs continuously in a direction (true: CCW) at a speed, until the speed is set to 0 or Stepper_Stop.
+   Can be called at any time: the motor ramps from its actual speed with the acceleration and the deceleration
+   per tick, and reverses through zero speed without stopping. A movement in progress is taken over at its speed
+   and the queued ones are dropped. While the mode is active Stepper_IsBusy returns true and Stepper_MoveStart false.
+   The ramps are trapezoidal, the S-curve profile applies only to the queued movements.
+*/
+void               Stepper_VelocitySet(bool, uint32_t, uint16_t, uint16_t, uint16_t);
+
+/* STEP/DIR mode: the motor follows the STEP pulses counted in hardware and the DIR input (step_dir.h),
+   ratio sub-steps per pulse. The tick moves the coil angle by the pulses received since the previous tick,
+   so the rate is not limited by the tick. With STEP_DIR_INTERPOLATE the pulses are spread over the measured pulse
+   period instead, see step_dir.h. The DIR edges are latched against the pulse count, so a tick can hold pulses
+   in both directions. Runs until Stepper_Stop, Stepper_QuickStop or Stepper_Abort, which
+   stop the motor on the sub-step reached. While the mode is active Stepper_IsBusy returns true and the movements
+   and the velocity mode are refused.
+   returns: false if the motor is busy or the ratio is 0
+*/
+bool               Stepper_StepDirStart(uint8_t, uint16_t);
+
+/* Stopping from any context, also from interrupts, for example a limit switch pin ISR.
+   Stepper_QuickStop: the next tick starts decelerating with QUICK_STOP_DEC, the movements and the velocity mode are
+   dropped and Stepper_VelocitySet is ignored until the motor is at standstill. Worst case, from the speed limit, the
+   coils are released Stepper_SpeedMaxGet() / QUICK_STOP_DEC + 1 ticks after the request: 938 ticks, 46.9 ms, with the
+   default values, 32 times more at resolution 1.
+   Stepper_Abort: the coils are released at the next PWM update, without deceleration, within one tick (50 us).
+   returns: the position reached
+   Both report the position reached through the callback, on the last tick of the quick stop or from Stepper_Abort.
+   Stepper_StopLatencyGet: TCE0 clocks from the last quick stop request to its first decelerated tick,
+   or from the last abort to the PWM update that released the coils.
+*/
+void               Stepper_QuickStop(void);
+stepper_position_t Stepper_Abort(void);
+uint16_t           Stepper_StopLatencyGet(void);
+void               Stepper_StopCallbackRegister(stepper_stop_cb_t);
+
+/* Registers the function called with the position when the motor comes to standstill: at the end of the queued
+   movements, of the velocity mode or of a quick stop, and from Stepper_Abort. It runs from the tick, so it must be
+   short: planning the next movement there would overrun the tick, the homing sequence leaves it to Home_Task, see home.h.
+*/
+void               Stepper_IdleCallbackRegister(stepper_stop_cb_t);
+
+/* Position compare: a pulse of one tick on POSITION_COMPARE_PORT each time the position moves between X - 1 and X,
+   in either direction. The pulse starts in the tick of the sub-step, so its jitter is one tick at most.
+   Stepper_CompareListSet: X are the entries of a list in increasing order, the list is read until the compare is changed
+   Stepper_CompareIntervalSet: X = origin + k * interval, interval in sub-steps
+   Stepper_ComparePulsesGet: positions crossed since the compare was set, the crossings of one STEP/DIR tick share a pulse
+*/
+void               Stepper_CompareListSet(const stepper_position_t *, uint8_t);
+void               Stepper_CompareIntervalSet(stepper_position_t, uint16_t);
+void               Stepper_CompareDisable(void);
+uint16_t           Stepper_ComparePulsesGet(void);
+
+/* Encoder feedback, with ENCODER_FEEDBACK (encoder.h): every tick compares the encoder with the position and raises
+   the flag when they differ by more than the limit, so missed steps are seen during the movement.
+   Stepper_FollowErrorGet: position - encoder position [sub-steps]
+   Stepper_EncoderPositionGet: position measured by the encoder [sub-steps], Stepper_PositionSet moves it as well
+   Stepper_FollowErrorLimitSet: limit [sub-steps], FOLLOW_ERROR_LIMIT after Stepper_Init
+   Stepper_FollowErrorReset: clears the flag and aligns the encoder on the position, for example after homing.
+   In closed loop it only clears the flag.
+   The callback is called from the tick with the position when the flag is raised, it can call Stepper_QuickStop.
+*/
+stepper_position_t Stepper_FollowErrorGet(void);
+stepper_position_t Stepper_EncoderPositionGet(void);
+bool               Stepper_FollowErrorFlagGet(void);
+void               Stepper_FollowErrorLimitSet(stepper_position_t);
+void               Stepper_FollowErrorReset(void);
+void               Stepper_FollowErrorCallbackRegister(stepper_stop_cb_t);
+
+/* Closed loop mode, with ENCODER_FEEDBACK: the field leads the rotor measured by the encoder by at most
+   CLOSED_LOOP_LOAD_ANGLE, so the motor does not lose steps, and the coil current follows the following error from
+   CLOSED_LOOP_CURRENT_MIN up to I_OUT instead of being fixed. The movements, the velocity mode and the STEP/DIR mode
+   are planned as in open loop. At standstill the position is held instead of released.
+   Enabling holds the commanded angle with I_OUT for CLOSED_LOOP_ALIGN_TICKS, aligns the encoder on the position and
+   closes the loop; Stepper_IsBusy is true meanwhile. Stepper_Abort opens the loop.
+   returns: false if the motor is busy, or on enable without ENCODER_FEEDBACK
+*/
+bool               Stepper_ClosedLoopSet(bool);
+bool               Stepper_ClosedLoopIsActive(void);
+void               Stepper_ProfileSet(stepper_profile_t, uint16_t);  /* Applies to the movements queued next. jerk: DEGPS_TO_JERK */
+stepper_position_t Stepper_GetPosition(void);
+
+/* Coil resolution in microsteps per full-step: a power of two from 1 to STEPPER_RESOLUTION_MAX.
+   1 is the two-phase full-step drive. During a movement the change is applied at the next full-step position.
+   The resolution sets the highest speed, STEPPER_SPEED_MAX: fine resolutions for positioning, coarse ones for speed.
+   returns: false if the resolution is not valid, or if the motor or a queued movement is faster than it allows
+*/
+bool               Stepper_ResolutionSet(uint16_t);
+uint16_t           Stepper_ResolutionGet(void);
+uint32_t           Stepper_SpeedMaxGet(void);  /* STEPPER_SPEED_MAX of the resolution last set */
+void               Stepper_PositionSet(stepper_position_t);
+
+/* Updates the supply voltage [mV] used for the drive amplitude and the BEMF compensation.
+   Can be called at any time, also from interrupt context, for example from the ADC result callback.
+*/
+void               Stepper_VBusSet(uint16_t);
+
 #endif /*  STEPPER_H  */
\ No newline at end of file
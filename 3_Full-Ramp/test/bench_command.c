@@ -0,0 +1,223 @@
+/* Command protocol throughput (user-010): a host thread sends frames through a pseudo-terminal, which stands in for
+ * the USART0 line. The device side moves the received bytes into the receive ring buffer as the Receive Complete
+ * interrupt would, runs Command_Process as the main loop while the ticker thread runs the movements, and writes the
+ * replies back. Every frame must be answered, the frames per second of the parser are compared with the 115200 baud
+ * line. The host figure is not the AVR one: it shows that the parser and the ring buffer keep up without a loss. */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "stepper.c"
+#include "usart0.h"
+#include "command.c"
+#include "mock.h"
+
+
+#define VBUS            12000
+#define FRAMES          20000UL
+#define LINE_BYTES_S    11520UL         /* 115200 baud, 10 bits per byte */
+
+static int               host_fd;
+static int               device_fd;
+static volatile uint32_t replies;
+static volatile uint32_t reply_errors;
+static uint32_t          sent_bytes;
+
+static uint16_t Crc(const uint8_t *data, uint8_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    while(length--)
+        crc = _crc_ccitt_update(crc, *data++);
+    return crc;
+}
+
+static uint8_t Frame(uint8_t *frame, uint8_t command, const uint8_t *payload, uint8_t length)
+{
+    uint16_t crc;
+
+    frame[0] = COMMAND_SOF;
+    frame[1] = command;
+    frame[2] = length;
+    if(length != 0)
+        memcpy(&frame[3], payload, length);
+    crc = Crc(&frame[1], length + 2);
+    frame[3 + length] = (uint8_t)crc;
+    frame[4 + length] = (uint8_t)(crc >> 8);
+    return length + 5;
+}
+
+/* Host: a query of the position every other frame, between parameters, movements and stops */
+static void *HostWriter(void *argument)
+{
+    static const uint8_t params[] = { 0x10, 0x00, 0x10, 0x00, 0x00, 0x40, 0x00, 0x00 };
+    uint8_t              frame[32];
+    uint8_t              payload[4];
+    uint32_t             k;
+
+    (void)argument;
+    for(k = 0; k < FRAMES; k++)
+    {
+        uint8_t size;
+        ssize_t sent = 0;
+
+        switch(k & 7)
+        {
+            case 1:
+                size = Frame(frame, COMMAND_SET_PARAMS, params, sizeof(params));
+                break;
+            case 3:
+                payload[0] = (uint8_t)k;
+                payload[1] = (uint8_t)(k >> 8);
+                payload[2] = 0;
+                payload[3] = 0;
+                size = Frame(frame, COMMAND_MOVE, payload, 4);
+                break;
+            case 5:
+                size = Frame(frame, COMMAND_STOP, NULL, 0);
+                break;
+            default:
+                size = Frame(frame, COMMAND_QUERY_POSITION, NULL, 0);
+                break;
+        }
+        while(sent < size)
+        {
+            ssize_t n = write(host_fd, frame + sent, size - sent);
+
+            if(n > 0)
+                sent += n;
+        }
+        sent_bytes += size;
+    }
+    return NULL;
+}
+
+/* Host: checks the replies as they come */
+static void *HostReader(void *argument)
+{
+    uint8_t  buffer[256];
+    uint8_t  reply[32];
+    uint8_t  count = 0;
+
+    (void)argument;
+    while(replies < FRAMES)
+    {
+        ssize_t n = read(host_fd, buffer, sizeof(buffer));
+        ssize_t k;
+
+        for(k = 0; k < n; k++)
+        {
+            reply[count++] = buffer[k];
+            if((count == 1) && (reply[0] != COMMAND_SOF))
+            {
+                reply_errors++;
+                count = 0;
+            }
+            else if((count >= 3) && (count == reply[2] + 5))
+            {
+                if((Crc(&reply[1], count - 3) != (reply[count - 2] | ((uint16_t)reply[count - 1] << 8)))
+                   || ((reply[1] & COMMAND_REPLY) == 0) || (reply[3] != COMMAND_STATUS_OK && reply[3] != COMMAND_STATUS_BUSY))
+                    reply_errors++;
+                replies++;
+                count = 0;
+            }
+            else if(count >= sizeof(reply))
+            {
+                reply_errors++;
+                count = 0;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Device: the receive interrupt and the main loop */
+static void Device(void)
+{
+    while(replies < FRAMES)
+    {
+        uint8_t buffer[USART0_RX_BUFFER_SIZE];
+        uint8_t space;
+        ssize_t n;
+        ssize_t k;
+
+        /* The ring keeps one byte free, the pseudo-terminal holds the rest as the line would */
+        space = (uint8_t)(USART0_RX_BUFFER_SIZE - 1U - USART0_RxCountGet());
+        n = (space != 0) ? read(device_fd, buffer, space) : 0;
+        for(k = 0; k < n; k++)
+            Mock_RxByte(buffer[k]);
+
+        Command_Process(VBUS);
+        if(mock_tx_count != 0)
+        {
+            uint16_t sent = 0;
+
+            while(sent < mock_tx_count)
+            {
+                ssize_t m = write(device_fd, mock_tx + sent, mock_tx_count - sent);
+
+                if(m > 0)
+                    sent += (uint16_t)m;
+            }
+            mock_tx_count = 0;
+        }
+    }
+}
+
+static void Raw(int fd)
+{
+    struct termios settings;
+
+    tcgetattr(fd, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(fd, TCSANOW, &settings);
+}
+
+int main(void)
+{
+    pthread_t       writer;
+    pthread_t       reader;
+    struct timespec start;
+    struct timespec end;
+    double          seconds;
+    double          bytes_s;
+
+    host_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(host_fd >= 0, "no pseudo-terminal");
+    if(host_fd < 0)
+        return Mock_Result("bench_command");
+    grantpt(host_fd);
+    unlockpt(host_fd);
+    device_fd = open(ptsname(host_fd), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    CHECK(device_fd >= 0, "pseudo-terminal not opened");
+    Raw(host_fd);
+    Raw(device_fd);
+
+    Stepper_Init();
+    Stepper_VBusSet(VBUS);
+    Command_Init();
+    Mock_TickerStart(Stepper_TimeTick);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&reader, NULL, HostReader, NULL);
+    pthread_create(&writer, NULL, HostWriter, NULL);
+    Device();
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    Mock_TickerStop();
+
+    seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+    bytes_s = (double)sent_bytes / seconds;
+    printf("bench_command: %lu frames answered in %.3f s, %.0f frames/s, %.0f received bytes/s, %.0f times the 115200 baud line\n",
+           (unsigned long)replies, seconds, (double)FRAMES / seconds, bytes_s, bytes_s / LINE_BYTES_S);
+    CHECK(replies == FRAMES, "%lu replies for %lu frames", (unsigned long)replies, FRAMES);
+    CHECK(reply_errors == 0, "%lu wrong replies", (unsigned long)reply_errors);
+    CHECK(bytes_s > LINE_BYTES_S, "the parser is slower than the line");
+    close(device_fd);
+    close(host_fd);
+    return Mock_Result("bench_command");
+}
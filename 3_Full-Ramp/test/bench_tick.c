@@ -0,0 +1,155 @@
+/* Tick time (user-024): Stepper_TimeTick is timed on the host with the closed loop, the position compare at every
+ * sub-step and the planner all active, the main loop keeping the queue full of movements as an application streaming
+ * a path would. Each scenario runs REPEATS times and every tick keeps its shortest time, so a preemption of the host
+ * is not taken for a long tick; the longest of these is the worst case of the scenario, against the 50 us period.
+ * The open loop movement alone is the reference of the mean tick. The host figure is not the AVR one: it ranks the tick paths, gives the share of the closed loop
+ * and of the planner, and the longest ATOMIC_BLOCK of the main loop, which holds the tick off. On the board the demo
+ * prints Stepper_TickClocksMaxGet, the longest tick in TCE0 clocks out of TICK_CLOCKS. */
+#include <time.h>
+#include "stepper.c"
+#include "mock.h"
+#include "motor.h"
+
+
+#define VBUS            12000
+#define ACCELERATION    DEGPS_TO_U16(3)
+#define JERK            DEGPS_TO_JERK(0.05)
+#define REPEATS         20
+#define TICKS           20000UL
+
+typedef struct
+{
+    const char        *name;
+    uint16_t           resolution;
+    bool               closed_loop;
+    bool               compare;
+    bool               stream;                  /* The main loop keeps the queue full, the planner runs between ticks */
+    stepper_profile_t  profile;
+} scenario_t;
+
+static uint64_t tick_ns[TICKS];
+
+static uint64_t Now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/* Queues movements in the same direction until the queue is full, of lengths that change the planned speeds */
+static void Stream(uint32_t *count)
+{
+    while(Stepper_QueueIsFull() == false)
+    {
+        stepper_position_t steps = 40 + (stepper_position_t)((*count * 397) % 1500);
+
+        CHECK(Stepper_MoveStart(steps, ACCELERATION, ACCELERATION, UINT32_MAX, VBUS), "movement refused");
+        (*count)++;
+    }
+}
+
+static void Setup(const scenario_t *scenario)
+{
+    uint16_t k;
+
+    Motor_Reset(0);
+    Encoder_Initialize();
+    Stepper_Init();
+    Stepper_VBusSet(VBUS);
+    Stepper_FollowErrorReset();
+    CHECK(Stepper_ResolutionSet(scenario->resolution), "%s: resolution refused", scenario->name);
+    Stepper_ProfileSet(scenario->profile, JERK);
+    if(scenario->compare)
+        Stepper_CompareIntervalSet(0, 1);
+    if(scenario->closed_loop)
+    {
+        CHECK(Stepper_ClosedLoopSet(true), "%s: closed loop refused", scenario->name);
+        for(k = 0; k <= CLOSED_LOOP_ALIGN_TICKS; k++)
+        {
+            Stepper_TimeTick();
+            Motor_Tick();
+        }
+        CHECK(Stepper_ClosedLoopIsActive(), "%s: loop not closed", scenario->name);
+    }
+}
+
+/* Runs the scenario, returns its mean tick in host nanoseconds */
+static double Run(const scenario_t *scenario, double reference)
+{
+    uint64_t worst = 0;
+    uint64_t total = 0;
+    uint64_t atomic_ns = UINT64_MAX;
+    uint32_t worst_tick = 0;
+    uint32_t moves = 0;
+    uint32_t tick;
+    uint8_t  repeat;
+
+    for(tick = 0; tick < TICKS; tick++)
+        tick_ns[tick] = UINT64_MAX;
+
+    for(repeat = 0; repeat < REPEATS; repeat++)
+    {
+        Setup(scenario);
+        moves = 0;
+        if(scenario->stream)
+            Stream(&moves);
+        else
+            CHECK(Stepper_MoveStart(1000000, ACCELERATION, ACCELERATION, UINT32_MAX, VBUS), "%s: movement refused", scenario->name);
+        mock_atomic_ns_max = 0;
+
+        for(tick = 0; tick < TICKS; tick++)
+        {
+            uint64_t start = Now();
+            uint64_t ns;
+
+            Stepper_TimeTick();
+            ns = Now() - start;
+            if(ns < tick_ns[tick])
+                tick_ns[tick] = ns;
+            Motor_Tick();
+            if(scenario->stream)
+                Stream(&moves);
+        }
+        CHECK(Stepper_IsBusy(), "%s: stopped before the end of the run", scenario->name);
+        if(mock_atomic_ns_max < atomic_ns)
+            atomic_ns = mock_atomic_ns_max;
+    }
+
+    for(tick = 0; tick < TICKS; tick++)
+    {
+        total += tick_ns[tick];
+        if(tick_ns[tick] > worst)
+        {
+            worst = tick_ns[tick];
+            worst_tick = tick;
+        }
+    }
+    printf("%-40s worst %4.0f ns (tick %5lu), %.2f %% of the period, mean %4.0f ns, %4.2f times the reference, "
+           "%lu movements, longest ATOMIC_BLOCK %.0f ns\n", scenario->name, (double)worst, (unsigned long)worst_tick,
+           (double)worst / (TICK_INTERVAL * 10.0), (double)total / TICKS,
+           (reference != 0) ? (double)total / TICKS / reference : 1.0, (unsigned long)moves, (double)atomic_ns);
+    CHECK(worst + atomic_ns < TICK_INTERVAL * 1000UL, "%s: the tick and the longest ATOMIC_BLOCK overrun the period", scenario->name);
+    return (double)total / TICKS;
+}
+
+int main(void)
+{
+    static const scenario_t reference =
+        { "open loop, one movement",                 K_MODE, false, false, false, STEPPER_PROFILE_TRAPEZOID };
+    static const scenario_t scenarios[] =
+    {
+        { "closed loop, one movement",               K_MODE, true,  false, false, STEPPER_PROFILE_TRAPEZOID },
+        { "closed loop, compare, planner",           K_MODE, true,  true,  true,  STEPPER_PROFILE_TRAPEZOID },
+        { "closed loop, compare, planner, S-curve",  K_MODE, true,  true,  true,  STEPPER_PROFILE_SCURVE },
+        { "closed loop, compare, planner, res. 1",   1,      true,  true,  true,  STEPPER_PROFILE_TRAPEZOID },
+    };
+    double  reference_ns;
+    uint8_t k;
+
+    reference_ns = Run(&reference, 0);
+    for(k = 0; k < sizeof(scenarios) / sizeof(scenarios[0]); k++)
+        Run(&scenarios[k], reference_ns);
+
+    return Mock_Result("bench_tick");
+}
@@ -0,0 +1,97 @@
+#ifndef MOCK_AVR_IO_H
+#define MOCK_AVR_IO_H
+
+
+#include <stdint.h>
+
+
+/* Host replacement of <avr/io.h>: only the registers and bit names used by the stepper sources.
+ * The register blocks are plain variables defined in mock.c, the tests write their inputs and read their outputs. */
+
+#define ISR(vector)                             void vector(void)
+
+#define PIN0_bm                                 0x01
+#define PIN1_bm                                 0x02
+#define PIN2_bm                                 0x04
+#define PIN3_bm                                 0x08
+#define PIN4_bm                                 0x10
+#define PIN5_bm                                 0x20
+#define PIN6_bm                                 0x40
+#define PIN7_bm                                 0x80
+
+typedef struct
+{
+    volatile uint8_t DIR, DIRSET, DIRCLR, DIRTGL;
+    volatile uint8_t OUT, OUTSET, OUTCLR, OUTTGL;
+    volatile uint8_t IN, INTFLAGS, PORTCTRL, PINCONFIG, PINCTRLUPD, PINCTRLSET, PINCTRLCLR, EVGENCTRLA;
+    volatile uint8_t PIN0CTRL, PIN1CTRL, PIN2CTRL, PIN3CTRL, PIN4CTRL, PIN5CTRL, PIN6CTRL, PIN7CTRL;
+} PORT_t;
+
+typedef struct
+{
+    volatile uint8_t DIR, OUT, IN, INTFLAGS;
+} VPORT_t;
+
+#define PORT_PULLUPEN_bm                        0x08
+#define PORT_INVEN_bm                           0x80
+#define PORT_ISC_gm                             0x07
+#define PORT_ISC_INTDISABLE_gc                  0x00
+#define PORT_ISC_BOTHEDGES_gc                   0x01
+#define PORT_ISC_RISING_gc                      0x02
+#define PORT_ISC_FALLING_gc                     0x03
+#define PORT_EVGEN0SEL_gm                       0x07
+#define PORT_EVGEN0SEL_PIN3_gc                  0x03
+
+typedef struct
+{
+    volatile uint8_t EVSYSROUTEA, CCLROUTEA, USARTROUTEA, SPIROUTEA, TWIROUTEA, TCEROUTEA, TCBROUTEA, TCFROUTEA;
+} PORTMUX_t;
+
+#define PORTMUX_TCE0_PORTA_gc                   0x00
+#define PORTMUX_TCE0_PORTD_gc                   0x03
+
+typedef struct
+{
+    volatile uint8_t CHANNEL0, CHANNEL1, CHANNEL2, CHANNEL3, CHANNEL4, CHANNEL5;
+    volatile uint8_t USERTCB0COUNT;
+} EVSYS_t;
+
+#define EVSYS_CHANNEL_PORTD_EVGEN0_gc           0x44
+#define EVSYS_USER_CHANNEL2_gc                  0x03
+
+/* TCB0 counts the STEP edges: a test adds its pulses to TCB0.CNT */
+typedef struct
+{
+    volatile uint8_t  CTRLA, CTRLB, EVCTRL, INTCTRL, INTFLAGS, STATUS;
+    volatile uint16_t CNT, CCMP;
+} TCB_t;
+
+#define TCB_ENABLE_bm                           0x01
+#define TCB_CLKSEL_EVENT_gc                     0x0E
+#define TCB_CNTMODE_INT_gc                      0x00
+
+typedef struct
+{
+    volatile uint8_t CTRLA, STATUS, LVL0PRI, LVL1VEC;
+} CPUINT_t;
+
+#define PORTD_PORT_vect_num                     25
+
+/* Types of the TCE0 driver prototypes, the driver itself is replaced by mock.c */
+typedef uint8_t TCE_WGMODE_t, TCE_CMD_t, TCE_CLKSEL_t, TCE_HREN_t, TCE_SCALEMODE_t;
+
+#define TCE_OVF_bm                              0x01
+
+typedef uint8_t ADC_MUXPOS_t, ADC_SAMPNUM_t;
+
+#define ADC_MUXPOS_AIN20_gc                     0x14
+#define ADC_SAMPNUM_ACC64_gc                    0x06
+
+extern PORT_t    PORTA, PORTC, PORTD, PORTF;
+extern VPORT_t   VPORTA, VPORTC, VPORTD, VPORTF;
+extern PORTMUX_t PORTMUX;
+extern EVSYS_t   EVSYS;
+extern TCB_t     TCB0;
+extern CPUINT_t  CPUINT;
+
+#endif /* MOCK_AVR_IO_H */
@@ -0,0 +1,43 @@
+#ifndef MOCK_H
+#define MOCK_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* TCE0 driver calls recorded by mock.c */
+extern volatile uint16_t mock_compare[4];       /* Last TCE0_CompareAllChannelsBufferedSet values */
+extern volatile uint16_t mock_amplitude;        /* Last TCE0_AmplitudeSet value */
+extern volatile uint32_t mock_compare_writes;   /* Number of TCE0_CompareAllChannelsBufferedSet calls */
+extern volatile uint16_t mock_counter;          /* Value read by TCE0_CounterGet */
+
+/* Runs tick() in a thread, as the TCE0 overflow interrupt, with the interrupts lock held during each call.
+   Needed by the blocking functions, such as Stepper_Move. The ticks are counted by mock_ticks. */
+extern volatile uint32_t mock_ticks;
+void Mock_TickerStart(void (*tick)(void));
+void Mock_TickerStop(void);
+
+/* Longest ATOMIC_BLOCK since the start, outer block only, in host nanoseconds: the time the tick can be held off */
+extern uint64_t mock_atomic_ns_max;
+
+/* Prints the failed condition and counts it, Mock_Result returns the exit code of the test */
+extern int mock_failures;
+
+#define CHECK(condition, ...)                                                               \
+    do                                                                                      \
+    {                                                                                       \
+        if(!(condition))                                                                    \
+        {                                                                                   \
+            mock_failures++;                                                                \
+            printf("%s:%d: FAIL %s: ", __FILE__, __LINE__, #condition);                     \
+            printf(__VA_ARGS__);                                                            \
+            printf("\n");                                                                   \
+        }                                                                                   \
+    } while(0)
+
+int Mock_Result(const char *name);
+
+#endif /* MOCK_H */
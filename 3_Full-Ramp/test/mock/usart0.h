@@ -0,0 +1,61 @@
+#ifndef MOCK_USART0_H
+#define MOCK_USART0_H
+
+/* Replaces mcc_generated_files/uart/usart0.h, which pulls in the system drivers: a test includes it before command.c,
+   the guard of the real header then skips it. The receive ring buffer has the size and the semantics of the driver,
+   the transmitted bytes are collected in mock_tx. */
+#define USART0_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define USART0_RX_BUFFER_SIZE   (64U)
+#define USART0_RX_BUFFER_MASK   (USART0_RX_BUFFER_SIZE - 1U)
+
+static uint8_t  mock_rx[USART0_RX_BUFFER_SIZE];
+static uint8_t  mock_rx_head;
+static uint8_t  mock_rx_tail;
+
+static uint8_t  mock_tx[1024];
+static uint16_t mock_tx_count;
+
+/* Receive Complete interrupt: false when the buffer is full and the byte is lost */
+static bool Mock_RxByte(uint8_t data)
+{
+    uint8_t next = (mock_rx_head + 1U) & USART0_RX_BUFFER_MASK;
+
+    if(next == mock_rx_tail)
+        return false;
+    mock_rx[mock_rx_head] = data;
+    mock_rx_head = next;
+    return true;
+}
+
+static uint8_t USART0_RxCountGet(void)
+{
+    return (mock_rx_head - mock_rx_tail) & USART0_RX_BUFFER_MASK;
+}
+
+static uint8_t USART0_RxPeek(uint8_t offset)
+{
+    return mock_rx[(mock_rx_tail + offset) & USART0_RX_BUFFER_MASK];
+}
+
+static void USART0_RxDiscard(uint8_t count)
+{
+    uint8_t available = USART0_RxCountGet();
+
+    if(count > available)
+        count = available;
+    mock_rx_tail = (mock_rx_tail + count) & USART0_RX_BUFFER_MASK;
+}
+
+static void USART0_Write(uint8_t data)
+{
+    if(mock_tx_count < sizeof(mock_tx))
+        mock_tx[mock_tx_count++] = data;
+}
+
+#endif /* MOCK_USART0_H */
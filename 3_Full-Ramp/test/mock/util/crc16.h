@@ -0,0 +1,17 @@
+#ifndef MOCK_UTIL_CRC16_H
+#define MOCK_UTIL_CRC16_H
+
+
+#include <stdint.h>
+
+
+/* The C equivalent given in the avr-libc documentation of <util/crc16.h> */
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+    data ^= (uint8_t)(crc & 0xFF);
+    data ^= (uint8_t)(data << 4);
+
+    return (uint16_t)((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+#endif /* MOCK_UTIL_CRC16_H */
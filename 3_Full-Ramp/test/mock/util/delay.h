@@ -0,0 +1,8 @@
+#ifndef MOCK_UTIL_DELAY_H
+#define MOCK_UTIL_DELAY_H
+
+
+void _delay_us(double us);
+void _delay_ms(double ms);
+
+#endif /* MOCK_UTIL_DELAY_H */
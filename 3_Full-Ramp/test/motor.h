@@ -0,0 +1,98 @@
+#ifndef MOTOR_H
+#define MOTOR_H
+
+
+#include <math.h>
+
+
+/* Rotor of a two-phase hybrid stepper and its quadrature encoder, for the tests with ENCODER_FEEDBACK.
+ * Included after stepper.c: the coil currents follow the compare values and the amplitude without the BEMF
+ * compensation, relative to the rated current. The torque pulls the rotor toward the field angle, a detent torque
+ * toward the full-steps, and every encoder edge calls Encoder_PinHandler as the pin interrupt. The angles are
+ * electrical radians, 2 pi being 4 full-steps. */
+
+#define MOTOR_TORQUE            2e-4    /* Holding torque at the rated current, in the integration unit */
+#define MOTOR_DAMPING           0.01
+#define MOTOR_DETENT            1e-5
+#define MOTOR_STEPS_PER_TICK    10      /* Integration steps per tick */
+
+static double motor_angle;
+static double motor_velocity;
+static long   motor_edges;
+static double motor_load;               /* Constant load torque, in the unit of MOTOR_TORQUE */
+
+static double MotorSubsteps(double angle)
+{
+    return angle * (4 * K_MODE) / (2 * M_PI);
+}
+
+/* Rotor position in sub-steps */
+static double Motor_PositionGet(void)
+{
+    return MotorSubsteps(motor_angle);
+}
+
+static void MotorEncoderState(long edges)
+{
+    static const uint8_t gray[4] = { 0, 2, 3, 1 };
+    uint8_t state = gray[((edges % 4) + 4) % 4];
+
+    ENCODER_PORT.IN = (uint8_t)(((state & 2) ? (1 << ENCODER_A_PIN) : 0) | ((state & 1) ? (1 << ENCODER_B_PIN) : 0));
+}
+
+static void MotorEncoderUpdate(void)
+{
+    long target = (long)floor(Motor_PositionGet() * ENCODER_COUNTS_PER_REV / SUBSTEPS_PER_REV);
+
+    while(motor_edges < target)
+    {
+        MotorEncoderState(++motor_edges);
+        Encoder_PinHandler();
+    }
+    while(motor_edges > target)
+    {
+        MotorEncoderState(--motor_edges);
+        Encoder_PinHandler();
+    }
+}
+
+/* Places the rotor at rest at position [sub-steps], before Encoder_Initialize */
+static void Motor_Reset(double position)
+{
+    motor_angle = position * 2 * M_PI / (4 * K_MODE);
+    motor_velocity = 0;
+    motor_edges = (long)floor(position * ENCODER_COUNTS_PER_REV / SUBSTEPS_PER_REV);
+    MotorEncoderState(motor_edges);
+}
+
+/* Turns the rotor by hand, by sub-steps, with the encoder following */
+static void Motor_Displace(double substeps)
+{
+    motor_angle += substeps * 2 * M_PI / (4 * K_MODE);
+    MotorEncoderUpdate();
+}
+
+/* Moves the rotor for one tick with the coil currents set by the tick */
+static void Motor_Tick(void)
+{
+    double a = ((double)mock_compare[1] - mock_compare[0]) / 32768;
+    double b = ((double)mock_compare[3] - mock_compare[2]) / 32768;
+    double field = atan2(b, a);
+    double magnitude = sqrt(a * a + b * b);
+    double current = (amplitude != 0) ? ((double)mock_amplitude - DynamicAmplitude()) / amplitude : 0;
+    uint8_t k;
+
+    if(current < 0)
+        current = 0;
+    for(k = 0; k < MOTOR_STEPS_PER_TICK; k++)
+    {
+        double torque = MOTOR_TORQUE * current * magnitude * sin(field - motor_angle) - MOTOR_DAMPING * motor_velocity
+                        - MOTOR_DETENT * sin(4 * motor_angle) - motor_load;
+
+        motor_velocity += torque / MOTOR_STEPS_PER_TICK;
+        motor_angle += motor_velocity / MOTOR_STEPS_PER_TICK;
+    }
+    MotorEncoderUpdate();
+}
+
+#endif /* MOTOR_H */
@@ -0,0 +1,205 @@
+/* Command protocol (user-010): the frames are parsed in place from the receive ring buffer, the CRC-16 is checked,
+ * the corrupted frames and the bytes outside a frame are dropped without reply and the parser resynchronizes on the
+ * next SOF, a frame split over several calls or over the end of the ring is parsed once complete. */
+#include <string.h>
+#include "stepper.c"
+#include "usart0.h"
+#include "command.c"
+#include "mock.h"
+
+
+#define VBUS            12000
+
+static uint16_t Crc(const uint8_t *data, uint8_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    while(length--)
+        crc = _crc_ccitt_update(crc, *data++);
+    return crc;
+}
+
+/* Builds a frame, returns its size */
+static uint8_t Frame(uint8_t *frame, uint8_t command, const uint8_t *payload, uint8_t length)
+{
+    uint16_t crc;
+
+    frame[0] = COMMAND_SOF;
+    frame[1] = command;
+    frame[2] = length;
+    if(length != 0)
+        memcpy(&frame[3], payload, length);
+    crc = Crc(&frame[1], length + 2);
+    frame[3 + length] = (uint8_t)crc;
+    frame[4 + length] = (uint8_t)(crc >> 8);
+    return length + 5;
+}
+
+static void Receive(const uint8_t *data, uint8_t size)
+{
+    while(size--)
+        CHECK(Mock_RxByte(*data++), "receive buffer full");
+}
+
+/* Checks that the transmitted bytes are exactly one valid reply to command with status, returns its data */
+static const uint8_t *Reply(const char *name, uint8_t command, uint8_t status, uint8_t length)
+{
+    uint16_t crc;
+
+    if(mock_tx_count != (uint16_t)(length + 6))
+    {
+        CHECK(false, "%s: %u bytes sent for a reply of %u data bytes", name, mock_tx_count, length);
+        mock_tx_count = 0;
+        return mock_tx;
+    }
+    crc = Crc(&mock_tx[1], length + 3);
+    CHECK(mock_tx[0] == COMMAND_SOF, "%s: SOF %02X", name, mock_tx[0]);
+    CHECK(mock_tx[1] == (command | COMMAND_REPLY), "%s: reply to %02X", name, mock_tx[1]);
+    CHECK(mock_tx[2] == length + 1, "%s: length %u", name, mock_tx[2]);
+    CHECK(mock_tx[3] == status, "%s: status %u, expected %u", name, mock_tx[3], status);
+    CHECK(crc == (mock_tx[4 + length] | ((uint16_t)mock_tx[5 + length] << 8)), "%s: reply CRC", name);
+    mock_tx_count = 0;
+    return &mock_tx[4];
+}
+
+static void NoReply(const char *name)
+{
+    CHECK(mock_tx_count == 0, "%s: %u bytes sent", name, mock_tx_count);
+    mock_tx_count = 0;
+}
+
+static void Run(uint32_t ticks)
+{
+    while(ticks--)
+        Stepper_TimeTick();
+}
+
+static stepper_position_t Query(const char *name, bool *busy)
+{
+    uint8_t        frame[32];
+    const uint8_t *data;
+
+    Receive(frame, Frame(frame, COMMAND_QUERY_POSITION, NULL, 0));
+    Command_Process(VBUS);
+    data = Reply(name, COMMAND_QUERY_POSITION, COMMAND_STATUS_OK, 5);
+    *busy = data[4];
+    return (stepper_position_t)((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+}
+
+int main(void)
+{
+    static const uint8_t check[] = "123456789";
+    static const uint8_t params[] = { 0x10, 0x00, 0x10, 0x00, 0x00, 0x40, 0x00, 0x00 };
+    static const uint8_t target[] = { 0x40, 0x06, 0x00, 0x00 };
+    static const uint8_t jog[] = { 0x01, 0x00, 0x20 };
+    uint8_t              frame[64];
+    uint8_t              size;
+    uint8_t              k;
+    bool                 busy;
+    stepper_position_t   position;
+
+    /* CRC-16/MCRF4XX check value, the CRC of the frames */
+    CHECK(Crc(check, 9) == 0x6F91, "CRC of 123456789: %04X", Crc(check, 9));
+
+    Stepper_Init();
+    Stepper_VBusSet(VBUS);
+    Command_Init();
+
+    /* Parameters and a movement of 1600 sub-steps, run to its end */
+    Receive(frame, Frame(frame, COMMAND_SET_PARAMS, params, sizeof(params)));
+    Command_Process(VBUS);
+    Reply("params", COMMAND_SET_PARAMS, COMMAND_STATUS_OK, 0);
+    CHECK(speed_limit == 0x4000 && acceleration == 0x10 && deceleration == 0x10, "parameters not applied");
+    Receive(frame, Frame(frame, COMMAND_MOVE, target, sizeof(target)));
+    Command_Process(VBUS);
+    Reply("move", COMMAND_MOVE, COMMAND_STATUS_OK, 0);
+    Run(100);
+    position = Query("query moving", &busy);
+    CHECK(busy && (position > 0) && (position < 1600), "moving: position %ld", (long)position);
+    Run(100000);
+    position = Query("query end", &busy);
+    CHECK((busy == false) && (position == 1600), "end: position %ld, busy %d", (long)position, busy);
+
+    /* Wrong CRC: dropped without reply, the next frame is parsed */
+    size = Frame(frame, COMMAND_MOVE, target, sizeof(target));
+    frame[size - 1] ^= 0x01;
+    Receive(frame, size);
+    Command_Process(VBUS);
+    NoReply("wrong CRC");
+    position = Query("after wrong CRC", &busy);
+    CHECK((busy == false) && (position == 1600), "wrong CRC: the movement started");
+
+    /* Bytes outside a frame, with a SOF and a length above the maximum, and the start of a frame: dropped once the
+     * next frame shows that the length is wrong */
+    {
+        static const uint8_t noise[] = { 0x00, 0xFF, COMMAND_SOF, COMMAND_MOVE, 0xF0, 0x12, COMMAND_SOF, COMMAND_STOP };
+
+        Receive(noise, sizeof(noise));
+    }
+    Command_Process(VBUS);
+    NoReply("noise");
+    Receive(frame, Frame(frame, COMMAND_STOP, NULL, 0));
+    Command_Process(VBUS);
+    Reply("stop after noise", COMMAND_STOP, COMMAND_STATUS_OK, 0);
+
+    /* A truncated frame: its CRC is checked against the bytes of the next frame, which is found again */
+    {
+        static const uint8_t truncated[] = { COMMAND_SOF, COMMAND_MOVE, 4, 0x01, 0x02 };
+
+        Receive(truncated, sizeof(truncated));
+    }
+    Command_Process(VBUS);
+    NoReply("truncated");
+    position = Query("after a truncated frame", &busy);
+    CHECK((busy == false) && (position == 1600), "truncated: position %ld", (long)position);
+    CHECK(USART0_RxCountGet() == 0, "truncated: %u bytes left", USART0_RxCountGet());
+
+    /* A frame received a byte at a time over the end of the ring, parsed only once complete */
+    for(k = 0; k < 3; k++)
+    {
+        uint8_t n;
+
+        size = Frame(frame, COMMAND_QUERY_POSITION, NULL, 0);
+        for(n = 0; n < size; n++)
+        {
+            Command_Process(VBUS);
+            NoReply("partial frame");
+            Receive(&frame[n], 1);
+        }
+        Command_Process(VBUS);
+        Reply("byte by byte", COMMAND_QUERY_POSITION, COMMAND_STATUS_OK, 5);
+        CHECK(USART0_RxCountGet() == 0, "%u bytes left", USART0_RxCountGet());
+        mock_rx_head = mock_rx_tail = (uint8_t)(USART0_RX_BUFFER_SIZE - 2 - k);
+    }
+
+    /* Wrong length, unknown command and value out of range: answered with the status */
+    Receive(frame, Frame(frame, COMMAND_MOVE, target, 2));
+    Command_Process(VBUS);
+    Reply("wrong length", COMMAND_MOVE, COMMAND_STATUS_LENGTH, 0);
+    Receive(frame, Frame(frame, 0x33, NULL, 0));
+    Command_Process(VBUS);
+    Reply("unknown", 0x33, COMMAND_STATUS_UNKNOWN, 0);
+    {
+        static const uint8_t zero[8] = { 0 };
+
+        Receive(frame, Frame(frame, COMMAND_SET_PARAMS, zero, sizeof(zero)));
+    }
+    Command_Process(VBUS);
+    Reply("zero acceleration", COMMAND_SET_PARAMS, COMMAND_STATUS_VALUE, 0);
+
+    /* Jog CCW, then stop: the motor decelerates to standstill */
+    Receive(frame, Frame(frame, COMMAND_JOG, jog, sizeof(jog)));
+    Command_Process(VBUS);
+    Reply("jog", COMMAND_JOG, COMMAND_STATUS_OK, 0);
+    Run(2000);
+    position = Query("jog", &busy);
+    CHECK(busy && (position < 1600), "jog: position %ld", (long)position);
+    Receive(frame, Frame(frame, COMMAND_STOP, NULL, 0));
+    Command_Process(VBUS);
+    Reply("stop jog", COMMAND_STOP, COMMAND_STATUS_OK, 0);
+    Run(100000);
+    Query("stopped", &busy);
+    CHECK(busy == false, "jog not stopped");
+
+    return Mock_Result("test_command");
+}
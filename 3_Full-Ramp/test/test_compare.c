@@ -0,0 +1,116 @@
+/* Position compare (user-020): at the highest step rate, every compare position crossed raises a pulse of one tick
+ * on the output pin in the tick that reaches it, in both directions, for an interval and for a list. */
+#include "stepper.c"
+#include "mock.h"
+
+
+#define SPEED           SPEED_LIMIT(UINT16_MAX)
+#define ACCELERATION    2000
+#define TICKS_MAX       1000000UL
+
+/* Output pin followed through the OUTSET and OUTCLR writes of each tick */
+static bool     pin;
+static uint32_t rising_edges;
+static uint32_t wrong_ticks;
+
+/* Ticks the movement to its end. expected(position, step) tells if the sub-step from position - step to position
+ * crosses a compare position. */
+static void MoveRun(const char *name, stepper_position_t steps, bool (*expected)(stepper_position_t, int8_t))
+{
+    uint32_t ticks;
+
+    rising_edges = 0;
+    wrong_ticks = 0;
+    CHECK(Stepper_MoveStart(steps, ACCELERATION, ACCELERATION, SPEED, 12000), "%s: movement refused", name);
+    for(ticks = 0; Stepper_IsBusy() && (ticks < TICKS_MAX); ticks++)
+    {
+        stepper_position_t before = actual_position;
+        bool               hit;
+
+        POSITION_COMPARE_PORT.OUTSET = 0;
+        POSITION_COMPARE_PORT.OUTCLR = 0;
+        Stepper_TimeTick();
+        CHECK(labs(actual_position - before) <= 1, "%s: %ld sub-steps in a tick", name, labs(actual_position - before));
+        hit = (actual_position != before) && expected(actual_position, (int8_t)(actual_position - before));
+
+        /* A pulse lasts one tick: cleared at the start of the next */
+        if(pin)
+        {
+            CHECK(POSITION_COMPARE_PORT.OUTCLR & POSITION_COMPARE_PIN_bm, "%s: pulse longer than a tick", name);
+            pin = false;
+        }
+        if(POSITION_COMPARE_PORT.OUTSET & POSITION_COMPARE_PIN_bm)
+        {
+            pin = true;
+            rising_edges++;
+        }
+        if(pin != hit)
+            wrong_ticks++;
+    }
+    printf("%s: %ld sub-steps in %lu ticks, %lu pulses\n", name, (long)steps, (unsigned long)ticks, (unsigned long)rising_edges);
+    CHECK(wrong_ticks == 0, "%s: %lu ticks with a pulse and no crossing, or the reverse", name, (unsigned long)wrong_ticks);
+    CHECK(rising_edges == Stepper_ComparePulsesGet(), "%s: %lu pulses, %u counted", name, (unsigned long)rising_edges, Stepper_ComparePulsesGet());
+}
+
+/* Interval 200 from origin 100: X = 100 + 200 k, crossed between X - 1 and X */
+static bool Interval200(stepper_position_t position, int8_t step)
+{
+    stepper_position_t x = (step > 0) ? position : (position + 1);
+
+    return ((x - 100) % 200) == 0;
+}
+
+static bool Interval1(stepper_position_t position, int8_t step)
+{
+    (void)position;
+    (void)step;
+    return true;
+}
+
+static const stepper_position_t list[] = { -300, -1, 0, 1, 2, 250, 251, 4000 };
+
+static bool List(stepper_position_t position, int8_t step)
+{
+    stepper_position_t x = (step > 0) ? position : (position + 1);
+    uint8_t            k;
+
+    for(k = 0; k < sizeof(list) / sizeof(list[0]); k++)
+    {
+        if(list[k] == x)
+            return true;
+    }
+    return false;
+}
+
+int main(void)
+{
+    Stepper_Init();
+    Stepper_VBusSet(12000);
+
+    /* A line-scan camera every 200 sub-steps */
+    Stepper_CompareIntervalSet(100, 200);
+    MoveRun("interval 200 forward", 20000, Interval200);
+    CHECK(rising_edges == 100, "%lu pulses", (unsigned long)rising_edges);
+    Stepper_CompareIntervalSet(100, 200);
+    MoveRun("interval 200 back", -20000, Interval200);
+    CHECK(rising_edges == 100, "%lu pulses", (unsigned long)rising_edges);
+
+    /* Throughput: a pulse at every sub-step, at the speed limit */
+    Stepper_CompareIntervalSet(0, 1);
+    MoveRun("interval 1 forward", 20000, Interval1);
+    CHECK(rising_edges == 20000, "%lu pulses", (unsigned long)rising_edges);
+    Stepper_CompareIntervalSet(0, 1);
+    MoveRun("interval 1 back", -20000, Interval1);
+    CHECK(rising_edges == 20000, "%lu pulses", (unsigned long)rising_edges);
+
+    /* A list, with neighbouring positions */
+    Stepper_PositionSet(-1000);
+    Stepper_CompareListSet(list, sizeof(list) / sizeof(list[0]));
+    MoveRun("list forward", 6000, List);
+    CHECK(rising_edges == 8, "%lu pulses", (unsigned long)rising_edges);
+    Stepper_CompareListSet(list, sizeof(list) / sizeof(list[0]));
+    MoveRun("list back", -6000, List);
+    CHECK(rising_edges == 8, "%lu pulses", (unsigned long)rising_edges);
+
+    return Mock_Result("test_compare");
+}
@@ -0,0 +1,94 @@
+/* Homing (user-019): the switch interrupt latches the position of the edge exactly, the sequence backs off, comes
+ * back slowly and makes the edge position 0. At the end the switch interrupt and the idle callback are released. */
+#include "stepper.c"
+#include "home.h"
+#include "mock.h"
+
+
+#define SEEK_SPEED      SPEED_LIMIT(DEGPS_TO_U16(90))
+#define APPROACH_SPEED  SPEED_LIMIT(DEGPS_TO_U16(36))      /* Stops a few sub-steps past the edge */
+#define ACCELERATION    DEGPS_TO_U16(0.3)
+#define SWITCH          (-5000)         /* The switch is active at and below this motor position */
+#define TICKS_MAX       2000000UL
+
+#define HOME_PIN_bm     (1 << HOME_PIN)
+
+/* Motor position, independent of the positions set by the homing */
+static stepper_position_t motor;
+
+/* One tick of the motor, then the switch pin: its rising edge interrupt runs before the next tick */
+static void Tick(void)
+{
+    stepper_position_t before = actual_position;
+    bool               active;
+
+    Stepper_TimeTick();
+    motor += actual_position - before;
+    active = (motor <= SWITCH);
+    if(active && ((HOME_PORT.IN & HOME_PIN_bm) == 0))
+    {
+        HOME_PORT.IN |= HOME_PIN_bm;
+        if(((&HOME_PORT.PIN0CTRL)[HOME_PIN] & PORT_ISC_gm) == PORT_ISC_RISING_gc)
+            Home_SwitchHandler();
+    }
+    else if(!active)
+    {
+        HOME_PORT.IN &= (uint8_t)~HOME_PIN_bm;
+    }
+}
+
+/* Runs the main loop of main.c, returns the final state */
+static home_state_t HomeRun(uint32_t stop_after)
+{
+    uint32_t ticks;
+
+    for(ticks = 0; (ticks < TICKS_MAX) && (Home_StateGet() != HOME_STATE_DONE) && (Home_StateGet() != HOME_STATE_FAILED); ticks++)
+    {
+        Tick();
+        if(ticks == stop_after)
+            Stepper_Stop();
+        Home_Task();
+    }
+    while(Stepper_IsBusy() && (ticks++ < TICKS_MAX))
+        Tick();
+    return Home_StateGet();
+}
+
+static void Released(const char *name)
+{
+    CHECK(idle_callback == NULL, "%s: idle callback still registered", name);
+    CHECK(((&HOME_PORT.PIN0CTRL)[HOME_PIN] & PORT_ISC_gm) == PORT_ISC_INTDISABLE_gc, "%s: switch interrupt still enabled", name);
+}
+
+int main(void)
+{
+    Stepper_Init();
+    Stepper_VBusSet(12000);
+
+    /* From the positive side, toward the switch (CCW) */
+    motor = 0;
+    CHECK(Home_Start(true, SEEK_SPEED, APPROACH_SPEED, ACCELERATION, ACCELERATION, 12000), "refused");
+    CHECK(HomeRun(UINT32_MAX) == HOME_STATE_DONE, "state %d", Home_StateGet());
+    printf("positive side: position %ld at motor %ld\n", (long)Stepper_GetPosition(), (long)motor);
+    CHECK(Stepper_GetPosition() == motor - SWITCH, "position %ld, switch edge at %ld", (long)Stepper_GetPosition(), (long)(motor - SWITCH));
+    Released("from the positive side");
+
+    /* Starting on the switch: back-off first */
+    Stepper_PositionSet(123);
+    motor = SWITCH - 50;
+    HOME_PORT.IN |= HOME_PIN_bm;
+    CHECK(Home_Start(true, SEEK_SPEED, APPROACH_SPEED, ACCELERATION, ACCELERATION, 12000), "refused");
+    CHECK(HomeRun(UINT32_MAX) == HOME_STATE_DONE, "state %d", Home_StateGet());
+    printf("on the switch: position %ld at motor %ld\n", (long)Stepper_GetPosition(), (long)motor);
+    CHECK(Stepper_GetPosition() == motor - SWITCH, "position %ld, switch edge at %ld", (long)Stepper_GetPosition(), (long)(motor - SWITCH));
+    Released("on the switch");
+
+    /* Stopped before the switch */
+    motor = 0;
+    HOME_PORT.IN &= (uint8_t)~HOME_PIN_bm;
+    CHECK(Home_Start(true, SEEK_SPEED, APPROACH_SPEED, ACCELERATION, ACCELERATION, 12000), "refused");
+    CHECK(HomeRun(2000) == HOME_STATE_FAILED, "state %d", Home_StateGet());
+    Released("stopped");
+
+    return Mock_Result("test_home");
+}
@@ -0,0 +1,82 @@
+/* Tick engine of the movements (user-001): a movement started with Stepper_MoveStart runs from Stepper_TimeTick,
+ * ends exactly on the target and follows the trapezoid within its speed limit and acceleration. */
+#include "stepper.c"
+#include "mock.h"
+
+
+#define SPEED           SPEED_LIMIT(DEGPS_TO_U16(360))
+#define ACCELERATION    DEGPS_TO_U16(0.3)
+#define TICKS_MAX       1000000UL
+
+/* Ticks the movement to its end and checks the profile, returns the ticks taken */
+static uint32_t MoveRun(stepper_position_t target, uint16_t speed, uint16_t rate)
+{
+    uint32_t           ticks = 0;
+    uint16_t           previous_speed = actual_speed;
+    uint16_t           top_speed = 0;
+    stepper_position_t previous_position = actual_position;
+    bool               backwards = (target < actual_position);
+
+    while(Stepper_IsBusy() && (ticks < TICKS_MAX))
+    {
+        uint32_t writes = mock_compare_writes;
+
+        Stepper_TimeTick();
+        ticks++;
+        CHECK(actual_speed <= speed, "tick %lu speed %u above %u", (unsigned long)ticks, actual_speed, speed);
+        /* The last sub-step is reached with some speed left, the movement ends there */
+        CHECK((((actual_speed > previous_speed) ? (actual_speed - previous_speed) : (previous_speed - actual_speed)) <= rate) ||
+              ((actual_speed == 0) && (Stepper_IsBusy() == false)),
+              "tick %lu speed change %u -> %u", (unsigned long)ticks, previous_speed, actual_speed);
+        CHECK(backwards ? (actual_position <= previous_position) : (actual_position >= previous_position),
+              "tick %lu position %ld after %ld", (unsigned long)ticks, (long)actual_position, (long)previous_position);
+        CHECK(mock_compare_writes <= writes + 1, "tick %lu wrote the compares more than once", (unsigned long)ticks);
+        if(actual_speed > top_speed)
+            top_speed = actual_speed;
+        previous_speed = actual_speed;
+        previous_position = actual_position;
+    }
+    CHECK(Stepper_IsBusy() == false, "still busy after %lu ticks", (unsigned long)ticks);
+    CHECK(Stepper_GetPosition() == target, "ended at %ld instead of %ld", (long)Stepper_GetPosition(), (long)target);
+    CHECK(top_speed == speed, "top speed %u instead of %u", top_speed, speed);
+    return ticks;
+}
+
+int main(void)
+{
+    uint32_t ticks;
+    uint8_t  queued;
+
+    Stepper_Init();
+    Stepper_VBusSet(12000);
+
+    /* Forward and back, as the demo of main.c */
+    CHECK(Stepper_MoveStart(STEPS_TO_SUBSTEPS(400), ACCELERATION, ACCELERATION, SPEED, 12000), "movement refused");
+    ticks = MoveRun(STEPS_TO_SUBSTEPS(400), SPEED, ACCELERATION);
+    printf("400 steps: %lu ticks\n", (unsigned long)ticks);
+#if (RELEASE_IN_IDLE == true)
+    CHECK((mock_compare[0] | mock_compare[1] | mock_compare[2] | mock_compare[3]) == DRIVE_ZERO, "coils not released");
+#endif
+    CHECK(Stepper_MoveStart(-STEPS_TO_SUBSTEPS(200), ACCELERATION, ACCELERATION, SPEED, 12000), "movement refused");
+    ticks = MoveRun(STEPS_TO_SUBSTEPS(200), SPEED, ACCELERATION);
+    printf("-200 steps: %lu ticks\n", (unsigned long)ticks);
+
+    /* Queued movements in the same direction are joined: the speed does not fall to zero between them */
+    for(queued = 0; Stepper_MoveStart(STEPS_TO_SUBSTEPS(100), ACCELERATION, ACCELERATION, SPEED, 12000); queued++);
+    CHECK(queued == STEPPER_QUEUE_SIZE - 1, "%u movements queued", queued);
+    CHECK(Stepper_QueueIsFull(), "queue not full");
+    {
+        uint32_t slow_ticks = 0;
+
+        for(ticks = 0; Stepper_IsBusy() && (ticks < TICKS_MAX); ticks++)
+        {
+            Stepper_TimeTick();
+            if((actual_speed == 0) && Stepper_IsBusy())
+                slow_ticks++;
+        }
+        CHECK(slow_ticks == 0, "stopped for %lu ticks between queued movements", (unsigned long)slow_ticks);
+        CHECK(Stepper_GetPosition() == STEPS_TO_SUBSTEPS(200 + 100 * (STEPPER_QUEUE_SIZE - 1)), "queue ended at %ld", (long)Stepper_GetPosition());
+    }
+
+    return Mock_Result("test_move");
+}
@@ -0,0 +1,92 @@
+/* Move verification (user-025), built with ENCODER_FEEDBACK and MOVE_VERIFY: after the movement the coils are
+ * released and the rotor is turned by hand by less than two full-steps. The correction must start the field from
+ * the rotor, not from the commanded angle that would pull the rotor back first, and end on the commanded position. */
+#include "stepper.c"
+#include "mock.h"
+#include "motor.h"
+
+
+#define SPEED           SPEED_LIMIT(DEGPS_TO_U16(360))
+#define ACCELERATION    DEGPS_TO_U16(0.3)
+
+/* Turn applied once the coils are released after the movement, in sub-steps */
+static volatile double displacement;
+static volatile bool   displace_armed;
+static volatile bool   displaced;
+
+/* After the turn: correction movements started, and the furthest the rotor went past the commanded position */
+static volatile stepper_position_t target;
+static volatile uint8_t            corrections;
+static volatile double             overshoot;
+
+static void Tick(void)
+{
+    bool busy = Stepper_IsBusy();
+    bool moving = segment_active;
+
+    Stepper_TimeTick();
+    Motor_Tick();
+    if(displace_armed && busy && (Stepper_IsBusy() == false))
+    {
+        displace_armed = false;
+        displaced = true;
+        Motor_Displace(displacement);
+    }
+    else if(displaced)
+    {
+        double past = (displacement < 0) ? (Motor_PositionGet() - target) : (target - Motor_PositionGet());
+
+        if((moving == false) && segment_active)
+            corrections++;
+        if(past > overshoot)
+            overshoot = past;
+    }
+}
+
+static void VerifiedMove(stepper_position_t steps, double turn)
+{
+    stepper_position_t start = Stepper_GetPosition();
+    stepper_position_t commanded;
+    stepper_position_t measured;
+
+    target = start + steps;
+    corrections = 0;
+    overshoot = 0;
+    displaced = false;
+    displacement = turn;
+    displace_armed = true;
+    commanded = Stepper_Move(start, steps, ACCELERATION, ACCELERATION, SPEED, 12000, &measured);
+    printf("%ld sub-steps, turned by %.0f: commanded %ld, measured %ld, rotor %.1f, %u correction(s), overshoot %.1f\n",
+           (long)steps, turn, (long)commanded, (long)measured, Motor_PositionGet(), corrections, overshoot);
+    CHECK(corrections == ((turn != 0) ? 1 : 0), "%u corrections", corrections);
+    CHECK(overshoot <= MOVE_VERIFY_TOLERANCE, "rotor went %.1f sub-steps past the commanded position", overshoot);
+    CHECK(commanded == start + steps, "commanded %ld instead of %ld", (long)commanded, (long)(start + steps));
+    CHECK(labs(measured - commanded) <= MOVE_VERIFY_TOLERANCE, "measured %ld, commanded %ld", (long)measured, (long)commanded);
+    CHECK(fabs(Motor_PositionGet() - commanded) <= MOVE_VERIFY_TOLERANCE, "rotor at %.1f, commanded %ld", Motor_PositionGet(), (long)commanded);
+}
+
+int main(void)
+{
+    Motor_Reset(0);
+    Encoder_Initialize();
+    Stepper_Init();
+    Stepper_VBusSet(12000);
+    Stepper_FollowErrorReset();
+    Mock_TickerStart(Tick);
+
+    /* Released coils: the rotor rests on a full-step, one full-step behind or ahead of the command */
+    VerifiedMove(STEPS_TO_SUBSTEPS(50), -STEPS_TO_SUBSTEPS(1));
+    VerifiedMove(STEPS_TO_SUBSTEPS(50), STEPS_TO_SUBSTEPS(1));
+    VerifiedMove(-STEPS_TO_SUBSTEPS(50), -STEPS_TO_SUBSTEPS(1));
+    VerifiedMove(-STEPS_TO_SUBSTEPS(50), STEPS_TO_SUBSTEPS(1));
+
+    /* Larger turns, beyond the reach of the commanded field */
+    VerifiedMove(STEPS_TO_SUBSTEPS(50), -STEPS_TO_SUBSTEPS(3));
+    VerifiedMove(STEPS_TO_SUBSTEPS(50), STEPS_TO_SUBSTEPS(5));
+
+    /* No turn: no correction */
+    VerifiedMove(STEPS_TO_SUBSTEPS(50), 0);
+
+    Mock_TickerStop();
+    return Mock_Result("test_move_verify");
+}
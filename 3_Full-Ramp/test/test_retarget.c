@@ -0,0 +1,103 @@
+/* Retargeting (user-017): Stepper_SetTarget during a movement keeps the speed continuous, ends exactly on the new
+ * target and, when the target is behind the motor or too close to stop on, overshoots by no more than the stop
+ * distance before coming back. */
+#include <math.h>
+#include "stepper.c"
+#include "mock.h"
+
+
+#define SPEED           SPEED_LIMIT(DEGPS_TO_U16(360))
+#define ACCELERATION    DEGPS_TO_U16(0.3)
+#define DECELERATION    DEGPS_TO_U16(0.6)
+#define TICKS_MAX       1000000UL
+
+/* A movement reaches its last sub-step with the speed of up to two sub-steps of deceleration left */
+#define REVERSAL_SPEED  (uint16_t)sqrt(2.0 * 2.0 * 65536.0 * DECELERATION)
+
+/* Sub-steps needed to stop from the actual speed with the deceleration, as the planner computes them, plus one */
+static stepper_position_t StopReach(void)
+{
+    return (stepper_position_t)(((uint32_t)actual_speed * actual_speed) / (2 * 65536UL * DECELERATION)) + 2;
+}
+
+/* Moves toward 100 steps for the given ticks, then retargets and runs to the end */
+static void Retarget(const char *name, uint32_t ticks_before, stepper_position_t target, uint16_t speed)
+{
+    uint32_t           ticks;
+    uint16_t           previous_speed;
+    bool               previous_direction;
+    stepper_position_t start;
+    stepper_position_t furthest;
+    stepper_position_t overshoot_limit;
+    uint8_t            reversals = 0;
+    uint8_t            stops = 0;
+    bool               forward;
+
+    Stepper_PositionSet(0);
+    CHECK(Stepper_MoveStart(STEPS_TO_SUBSTEPS(100), ACCELERATION, DECELERATION, SPEED, 12000), "%s: movement refused", name);
+    for(ticks = 0; ticks < ticks_before; ticks++)
+        Stepper_TimeTick();
+
+    start = actual_position;
+    furthest = start;
+    previous_speed = actual_speed;
+    previous_direction = direction;
+    forward = (actual_speed != 0) ? (direction == false) : (target >= start);
+    overshoot_limit = StopReach();
+    CHECK(Stepper_SetTarget(target, ACCELERATION, DECELERATION, speed, 12000), "%s: retarget refused", name);
+
+    for(ticks = 0; Stepper_IsBusy() && (ticks < TICKS_MAX); ticks++)
+    {
+        Stepper_TimeTick();
+        CHECK(((actual_speed + (uint32_t)DECELERATION >= previous_speed) && (actual_speed <= (uint32_t)previous_speed + ACCELERATION)) ||
+              (Stepper_IsBusy() == false), "%s: tick %lu speed %u -> %u", name, (unsigned long)ticks, previous_speed, actual_speed);
+        if((actual_speed == 0) && Stepper_IsBusy())
+            stops++;
+        if((direction != previous_direction) && (previous_speed != 0))
+        {
+            reversals++;
+            CHECK(previous_speed <= REVERSAL_SPEED, "%s: reversed at speed %u", name, previous_speed);
+        }
+        if(forward ? (actual_position > furthest) : (actual_position < furthest))
+            furthest = actual_position;
+        previous_speed = actual_speed;
+        previous_direction = direction;
+    }
+    CHECK(Stepper_GetPosition() == target, "%s: ended at %ld instead of %ld", name, (long)Stepper_GetPosition(), (long)target);
+    printf("%s: retarget at %ld, %lu ticks, %u reversal(s), furthest %ld\n", name, (long)start, (unsigned long)ticks, reversals, (long)furthest);
+    CHECK(stops <= 1, "%s: stopped %u ticks", name, stops);
+    if(forward ? (target >= start + overshoot_limit) : (target <= start - overshoot_limit))
+    {
+        /* Reachable in the same direction: no reversal, no overshoot */
+        CHECK(reversals == 0, "%s: %u reversals", name, reversals);
+        CHECK(furthest == target, "%s: went to %ld", name, (long)furthest);
+    }
+    else
+    {
+        /* Stopped as soon as the deceleration allows, then back */
+        CHECK(reversals == 1, "%s: %u reversals", name, reversals);
+        CHECK(labs(furthest - start) <= overshoot_limit, "%s: went %ld past, stop distance %ld", name, labs(furthest - start), (long)overshoot_limit);
+    }
+}
+
+int main(void)
+{
+    Stepper_Init();
+    Stepper_VBusSet(12000);
+
+    /* During the acceleration: further, closer but reachable, a slower speed limit */
+    Retarget("extend", 600, STEPS_TO_SUBSTEPS(300), SPEED);
+    Retarget("shorten", 600, STEPS_TO_SUBSTEPS(40), SPEED);
+    Retarget("slower", 3000, STEPS_TO_SUBSTEPS(100), SPEED / 2);
+
+    /* At cruise speed: behind the start, behind the motor, too close to stop on */
+    Retarget("overshoot", 4000, 0, SPEED);
+    Retarget("reverse", 4000, -STEPS_TO_SUBSTEPS(20), SPEED);
+    Retarget("close", 4000, STEPS_TO_SUBSTEPS(36), SPEED);
+
+    /* During the deceleration, further again, and at standstill, back */
+    Retarget("decelerating", 10600, STEPS_TO_SUBSTEPS(150), SPEED);
+    Retarget("standstill", 40000, -STEPS_TO_SUBSTEPS(10), SPEED);
+
+    return Mock_Result("test_retarget");
+}
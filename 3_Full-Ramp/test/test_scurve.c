@@ -0,0 +1,76 @@
+/* S-curve profile (user-003): the acceleration changes by at most the jerk per tick and never exceeds the
+ * acceleration of the movement. With the same peak acceleration, a continuous S-curve takes acceleration / jerk
+ * longer than the trapezoid; the ticks and the integer stop distances of the planner shift it by up to as much.
+ * Both movements end on the target. */
+#include "stepper.c"
+#include "mock.h"
+
+
+#define SPEED           SPEED_LIMIT(DEGPS_TO_U16(360))
+#define ACCELERATION    DEGPS_TO_U16(0.3)
+#define JERK            22              /* ACCELERATION / JERK = 200 ticks to reach the full acceleration */
+#define DISTANCE        STEPS_TO_SUBSTEPS(400)
+#define TICKS_MAX       1000000UL
+
+/* Speed with the S-curve fraction, in 1/256 of the speed unit */
+static int32_t SpeedFine(void)
+{
+    return ((int32_t)actual_speed << 8) | speed_fraction;
+}
+
+static uint32_t MoveRun(stepper_profile_t move_profile, uint16_t jerk)
+{
+    uint32_t ticks = 0;
+    int32_t  speed = SpeedFine();
+    int32_t  accel = 0;
+    int32_t  accel_max = 0;
+
+    Stepper_ProfileSet(move_profile, jerk);
+    CHECK(Stepper_MoveStart(DISTANCE, ACCELERATION, ACCELERATION, SPEED, 12000), "movement refused");
+    while(Stepper_IsBusy() && (ticks < TICKS_MAX))
+    {
+        int32_t new_speed;
+        int32_t new_accel;
+
+        Stepper_TimeTick();
+        ticks++;
+        new_speed = SpeedFine();
+        new_accel = new_speed - speed;
+        if(Stepper_IsBusy() && (move_profile == STEPPER_PROFILE_SCURVE))
+        {
+            /* The tick that reaches the target speed takes the rest of the speed difference and ends the rounding,
+             * a step below a tenth of the acceleration */
+            CHECK((labs(new_accel - accel) <= jerk) || ((actual_accel == 0) && (labs(new_accel - accel) <= ((int32_t)ACCELERATION << 8) / 10)),
+                  "tick %lu acceleration %ld -> %ld", (unsigned long)ticks, (long)accel, (long)new_accel);
+        }
+        CHECK(labs(new_accel) <= ((int32_t)ACCELERATION << 8) || (Stepper_IsBusy() == false),
+              "tick %lu acceleration %ld above %d", (unsigned long)ticks, (long)new_accel, ACCELERATION << 8);
+        if(Stepper_IsBusy() && (labs(new_accel) > accel_max))
+            accel_max = labs(new_accel);
+        speed = new_speed;
+        accel = new_accel;
+    }
+    CHECK(Stepper_GetPosition() == DISTANCE, "ended at %ld", (long)Stepper_GetPosition());
+    CHECK(accel_max == ((int32_t)ACCELERATION << 8), "peak acceleration %ld instead of %d", (long)accel_max, ACCELERATION << 8);
+    Stepper_PositionSet(0);
+    return ticks;
+}
+
+int main(void)
+{
+    uint32_t trapezoid;
+    uint32_t scurve;
+    uint32_t ramp = (ACCELERATION * 256UL) / JERK;
+
+    Stepper_Init();
+    Stepper_VBusSet(12000);
+
+    trapezoid = MoveRun(STEPPER_PROFILE_TRAPEZOID, 0);
+    scurve = MoveRun(STEPPER_PROFILE_SCURVE, JERK);
+    printf("trapezoid %lu ticks, S-curve %lu ticks, difference %lu, acceleration ramp %lu ticks\n",
+           (unsigned long)trapezoid, (unsigned long)scurve, (unsigned long)(scurve - trapezoid), (unsigned long)ramp);
+
+    CHECK((scurve > trapezoid) && (scurve - trapezoid <= 2 * ramp), "difference %lu, expected up to %lu", (unsigned long)(scurve - trapezoid), (unsigned long)(2 * ramp));
+
+    return Mock_Result("test_scurve");
+}
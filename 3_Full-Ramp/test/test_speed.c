@@ -0,0 +1,169 @@
+/* Speeds above one sub-step per tick (user-006, user-005): the electrical angle moves several sub-steps in a tick, the
+ * position counts every one of them and the position compare every crossing, also through the junctions of queued
+ * movements. The highest speed follows the coil resolution, one entry per tick: resolution 1 runs up to a full-step per
+ * tick, and a finer resolution is refused while the motor or its movements are faster than it allows. */
+#include <math.h>
+#include "stepper.c"
+#include "mock.h"
+
+
+#define ACCELERATION    2000
+#define INTERVAL        100
+#define TICKS_MAX       1000000UL
+
+static stepper_position_t crossings;
+static uint32_t           steps_max;
+
+/* Positions X = k * INTERVAL crossed between the positions from and to */
+static stepper_position_t Crossings(stepper_position_t from, stepper_position_t to)
+{
+    stepper_position_t low = (from < to) ? from : to;
+    stepper_position_t high = (from < to) ? to : from;
+
+    /* Crossed between X - 1 and X: X in low + 1 ... high */
+    return (stepper_position_t)(floor((double)high / INTERVAL) - floor((double)low / INTERVAL));
+}
+
+/* Ticks until the motor is idle, checking every tick. Returns the ticks taken. */
+static uint32_t Run(const char *name)
+{
+    uint32_t ticks;
+
+    for(ticks = 0; Stepper_IsBusy() && (ticks < TICKS_MAX); ticks++)
+    {
+        stepper_position_t before = actual_position;
+        stepper_position_t hits;
+        uint32_t           steps;
+
+        POSITION_COMPARE_PORT.OUTSET = 0;
+        Stepper_TimeTick();
+        steps = (uint32_t)labs(actual_position - before);
+        if(steps > steps_max)
+            steps_max = steps;
+        hits = Crossings(before, actual_position);
+        crossings += hits;
+
+        CHECK(steps <= K_MODE, "%s: %lu sub-steps in a tick", name, (unsigned long)steps);
+        CHECK(substep_reached == (uint16_t)(actual_position & SUBSTEP_MASK), "%s: tick %lu, angle at sub-step %u for position %ld",
+              name, (unsigned long)ticks, substep_reached, (long)actual_position);
+        CHECK(((POSITION_COMPARE_PORT.OUTSET & POSITION_COMPARE_PIN_bm) != 0) == (hits != 0), "%s: pulse in tick %lu for %ld crossings",
+              name, (unsigned long)ticks, (long)hits);
+    }
+    CHECK(electrical_phase == (uint32_t)((uint32_t)actual_position * PHASE_PER_SUBSTEP), "%s: angle off the position at the end", name);
+    CHECK(Stepper_ComparePulsesGet() == (uint16_t)crossings, "%s: %u positions counted for %ld crossings", name,
+          Stepper_ComparePulsesGet(), (long)crossings);
+    return ticks;
+}
+
+/* A movement from the position with the compare reset, returns the ticks taken */
+static uint32_t Move(const char *name, stepper_position_t steps, uint32_t speed)
+{
+    stepper_position_t start = actual_position;
+    uint32_t           ticks;
+
+    Stepper_CompareIntervalSet(0, INTERVAL);
+    crossings = 0;
+    steps_max = 0;
+    CHECK(Stepper_MoveStart(steps, ACCELERATION, ACCELERATION, speed, 12000), "%s: refused", name);
+    ticks = Run(name);
+    printf("%s: %ld sub-steps in %lu ticks, up to %lu sub-steps per tick, %ld compare positions\n", name, (long)steps,
+           (unsigned long)ticks, (unsigned long)steps_max, (long)crossings);
+    CHECK(actual_position == start + steps, "%s: end at %ld instead of %ld", name, (long)(actual_position - start), (long)steps);
+    return ticks;
+}
+
+int main(void)
+{
+    uint32_t ticks_fine;
+    uint32_t ticks_coarse;
+    uint32_t ticks_back;
+    uint16_t tick;
+
+    Stepper_Init();
+    Stepper_VBusSet(12000);
+
+    /* The default resolution, K_MODE: one sub-step per tick */
+    CHECK(Stepper_SpeedMaxGet() == 65536, "speed limit %lu", (unsigned long)Stepper_SpeedMaxGet());
+    CHECK(SPEED_LIMIT(UINT32_MAX) == Stepper_SpeedMaxGet(), "SPEED_LIMIT %lu", (unsigned long)SPEED_LIMIT(UINT32_MAX));
+    ticks_fine = Move("resolution 32", 200000, UINT32_MAX);
+    CHECK(steps_max == 1, "resolution 32: %lu sub-steps in a tick", (unsigned long)steps_max);
+
+    /* Resolution 1: a full-step per tick, forward and back */
+    CHECK(Stepper_ResolutionSet(1), "resolution 1 refused");
+    CHECK(Stepper_SpeedMaxGet() == STEPPER_SPEED_MAX(1), "speed limit %lu", (unsigned long)Stepper_SpeedMaxGet());
+    ticks_coarse = Move("resolution 1", 200000, UINT32_MAX);
+    CHECK(steps_max == K_MODE, "resolution 1: %lu sub-steps in a tick at most", (unsigned long)steps_max);
+    CHECK(ticks_coarse * 4 < ticks_fine, "resolution 1: %lu ticks, %lu at resolution 32", (unsigned long)ticks_coarse, (unsigned long)ticks_fine);
+    ticks_back = Move("resolution 1 back", -200001, UINT32_MAX);
+    CHECK(ticks_back <= ticks_coarse + 1, "resolution 1 back: %lu ticks, the last sub-steps crawled", (unsigned long)ticks_back);
+    Stepper_ProfileSet(STEPPER_PROFILE_SCURVE, 200);
+    Move("resolution 1 S-curve", 200003, UINT32_MAX);
+    Stepper_ProfileSet(STEPPER_PROFILE_TRAPEZOID, 0);
+
+    /* Queued movements joined at speed: the sub-steps of a tick beyond a junction go to the next movement, and
+     * the last one is not passed. Then a reversal, which stops in between. */
+    Stepper_CompareIntervalSet(0, INTERVAL);
+    crossings = 0;
+    {
+        stepper_position_t start = actual_position;
+
+        CHECK(Stepper_MoveStart(50001, ACCELERATION, ACCELERATION, UINT32_MAX, 12000)
+              && Stepper_MoveStart(333, ACCELERATION, ACCELERATION, UINT32_MAX, 12000)
+              && Stepper_MoveStart(49999, ACCELERATION, ACCELERATION, UINT32_MAX, 12000)
+              && Stepper_MoveStart(-30000, ACCELERATION, ACCELERATION, UINT32_MAX, 12000), "queue refused");
+        Run("queue");
+        CHECK(actual_position == start + 50001 + 333 + 49999 - 30000, "queue: end at %ld", (long)(actual_position - start));
+    }
+
+    /* A new target just ahead at full speed: stopped and brought back onto it */
+    Stepper_CompareIntervalSet(0, INTERVAL);
+    crossings = 0;
+    CHECK(Stepper_MoveStart(1000000, ACCELERATION, ACCELERATION, UINT32_MAX, 12000), "movement refused");
+    for(tick = 0; tick < 3000; tick++)
+        Stepper_TimeTick();
+    CHECK(actual_speed == STEPPER_SPEED_MAX(1), "speed %lu", (unsigned long)actual_speed);
+    crossings = Stepper_ComparePulsesGet();
+    {
+        stepper_position_t target = actual_position + 10;
+
+        CHECK(Stepper_SetTarget(target, ACCELERATION, ACCELERATION, UINT32_MAX, 12000), "target refused");
+        Run("target");
+        CHECK(actual_position == target, "target: end %ld away", (long)(actual_position - target));
+    }
+
+    /* A finer resolution is refused while the motor is faster than it allows, then taken at the next full-step */
+    Stepper_VelocitySet(true, UINT32_MAX, ACCELERATION, ACCELERATION, 12000);
+    for(tick = 0; tick < 2000; tick++)
+        Stepper_TimeTick();
+    CHECK(Stepper_ResolutionSet(K_MODE) == false, "finer resolution taken at %lu", (unsigned long)actual_speed);
+    CHECK(Stepper_ResolutionGet() == 1, "resolution %u", Stepper_ResolutionGet());
+    Stepper_VelocitySet(true, 30000, ACCELERATION, ACCELERATION, 12000);
+    for(tick = 0; tick < 2000; tick++)
+        Stepper_TimeTick();
+    CHECK(Stepper_ResolutionSet(K_MODE), "finer resolution refused at %lu", (unsigned long)actual_speed);
+    for(tick = 0; tick < 2000; tick++)
+        Stepper_TimeTick();
+    CHECK(angle_width == STEPPER_RESOLUTION_MAX / K_MODE, "resolution not taken over while moving");
+    Stepper_VelocitySet(true, UINT32_MAX, ACCELERATION, ACCELERATION, 12000);
+    for(tick = 0; tick < 2000; tick++)
+        Stepper_TimeTick();
+    CHECK(actual_speed == Stepper_SpeedMaxGet(), "velocity %lu above the limit of the resolution", (unsigned long)actual_speed);
+    Stepper_Stop();
+    Stepper_CompareIntervalSet(0, INTERVAL);
+    crossings = 0;
+    Run("velocity");
+
+    /* A queued movement faster than the finer resolution allows keeps the coarse one */
+    CHECK(Stepper_ResolutionSet(2), "resolution 2 refused");
+    CHECK(Stepper_MoveStart(100000, ACCELERATION, ACCELERATION, UINT32_MAX, 12000), "movement refused");
+    CHECK(Stepper_ResolutionSet(STEPPER_RESOLUTION_MAX) == false, "finer resolution taken with a fast movement queued");
+    Run("resolution 2");
+
+    /* At resolution 256 the movements are clamped to an eighth of a sub-step per tick */
+    CHECK(Stepper_ResolutionSet(STEPPER_RESOLUTION_MAX), "resolution 256 refused");
+    CHECK(Stepper_MoveStart(100, ACCELERATION, ACCELERATION, UINT32_MAX, 12000), "movement refused");
+    CHECK(queue[queue_head].speed_limit == STEPPER_SPEED_MAX(STEPPER_RESOLUTION_MAX), "speed limit %lu", (unsigned long)queue[queue_head].speed_limit);
+    Run("resolution 256");
+
+    return Mock_Result("test_speed");
+}
@@ -0,0 +1,225 @@
+/* STEP/DIR mode (user-021): the pulses counted by the mocked TCB0 move the motor by the ratio, through the 16-bit wrap
+ * of the counter, with the DIR edges latched against the count so that a reversal within a tick keeps the direction
+ * of every pulse. Without interpolation a tick of many pulses runs the position compare through
+ * PositionCompareJump. With STEP_DIR_INTERPOLATE (test_step_dir_interpolate) coarse pulses are spread over their
+ * period without passing the commanded position. */
+#include "stepper.c"
+#include "mock.h"
+
+
+/* Commanded position, in pulses */
+static int32_t commanded;
+
+/* STEP pulses on the input, counted by TCB0 in the direction set on the DIR pin */
+static void Pulses(uint16_t count)
+{
+    TCB0.CNT += count;
+    commanded += (DIR_PORT.IN & DIR_PIN_bm) ? -(int32_t)count : (int32_t)count;
+}
+
+/* DIR edge and its interrupt */
+static void Direction(bool ccw)
+{
+    if(ccw)
+        DIR_PORT.IN |= DIR_PIN_bm;
+    else
+        DIR_PORT.IN &= ~DIR_PIN_bm;
+    StepDir_DirectionHandler();
+}
+
+/* Positions X = origin + k * interval crossed between the positions from and to */
+static uint32_t Crossings(stepper_position_t origin, uint16_t interval, stepper_position_t from, stepper_position_t to)
+{
+    stepper_position_t low = (from < to) ? from : to;
+    stepper_position_t high = (from < to) ? to : from;
+    uint32_t           count = 0;
+    stepper_position_t x;
+
+    /* Crossed between X - 1 and X */
+    for(x = low + 1; x <= high; x++)
+    {
+        if((((x - origin) % interval) + interval) % interval == 0)
+            count++;
+    }
+    return count;
+}
+
+static void Start(uint8_t ratio)
+{
+    CHECK(Stepper_StepDirStart(ratio, 12000), "STEP/DIR mode refused");
+    commanded = 0;
+}
+
+static void Stop(void)
+{
+    Stepper_Stop();
+    Stepper_TimeTick();
+    CHECK(Stepper_IsBusy() == false, "the mode does not end");
+}
+
+#if (STEP_DIR_INTERPOLATE == false)
+/* Pulses applied in the tick that reads them, with the position compare */
+static void Direct(void)
+{
+    stepper_position_t start;
+    uint32_t           phase;
+    uint32_t           ticks;
+    uint32_t           pulse_ticks = 0;
+    uint32_t           crossings = 0;
+    uint32_t           k;
+
+    /* 1 sub-step per pulse, a burst of 500 pulses per tick with the compare every 100 sub-steps, through the wrap */
+    TCB0.CNT = 0xFF00;
+    Direction(false);
+    Start(1);
+    start = actual_position;
+    phase = electrical_phase;
+    Stepper_CompareIntervalSet(start + 50, 100);
+    for(ticks = 0; ticks < 20; ticks++)
+    {
+        stepper_position_t before = actual_position;
+
+        Pulses(500);
+        POSITION_COMPARE_PORT.OUTSET = 0;
+        Stepper_TimeTick();
+        CHECK(actual_position == start + commanded, "burst: position %ld for %ld", (long)(actual_position - start), (long)commanded);
+        k = Crossings(start + 50, 100, before, actual_position);
+        crossings += k;
+        if(POSITION_COMPARE_PORT.OUTSET & POSITION_COMPARE_PIN_bm)
+            pulse_ticks++;
+        CHECK(((POSITION_COMPARE_PORT.OUTSET & POSITION_COMPARE_PIN_bm) != 0) == (k != 0), "burst: pulse in tick %lu", (unsigned long)ticks);
+    }
+    printf("burst: %ld sub-steps in %lu ticks, %u positions crossed, %lu pulses\n", (long)(actual_position - start),
+           (unsigned long)ticks, Stepper_ComparePulsesGet(), (unsigned long)pulse_ticks);
+    CHECK(crossings == 100, "burst: %lu crossings", (unsigned long)crossings);
+    CHECK(Stepper_ComparePulsesGet() == crossings, "burst: %u counted for %lu", Stepper_ComparePulsesGet(), (unsigned long)crossings);
+    CHECK(electrical_phase - phase == (uint32_t)((uint32_t)(actual_position - start) * PHASE_PER_SUBSTEP), "burst: angle off the position");
+
+    /* Backwards, 8 sub-steps per pulse */
+    Stop();
+    Direction(true);
+    Start(8);
+    start = actual_position;
+    phase = electrical_phase;
+    Stepper_CompareIntervalSet(start - 3, 64);
+    for(ticks = 0; ticks < 50; ticks++)
+    {
+        Pulses((uint16_t)(ticks % 7));
+        Stepper_TimeTick();
+        CHECK(actual_position == start + 8 * commanded, "backwards: position %ld for %ld pulses", (long)(actual_position - start), (long)commanded);
+    }
+    CHECK(Stepper_ComparePulsesGet() == Crossings(start - 3, 64, start, actual_position), "backwards: %u counted", Stepper_ComparePulsesGet());
+    CHECK(direction == true, "backwards: direction");
+    CHECK(electrical_phase - phase == (uint32_t)((uint32_t)(actual_position - start) * PHASE_PER_SUBSTEP), "backwards: angle off the position");
+    Stepper_CompareDisable();
+
+    /* Reversals within a tick: the pulses before each DIR edge keep their direction */
+    for(ticks = 0; ticks < 200; ticks++)
+    {
+        Direction(false);
+        Pulses(30 + (ticks % 5));
+        Direction(true);
+        Pulses(10);
+        if(ticks & 1)
+        {
+            Direction(false);
+            Pulses(3);
+        }
+        Stepper_TimeTick();
+        CHECK(actual_position == start + 8 * commanded, "reversals: position %ld for %ld pulses", (long)(actual_position - start), (long)commanded);
+    }
+    printf("reversals: %ld pulses, motor at %ld sub-steps\n", (long)commanded, (long)(actual_position - start));
+
+    /* The pulses after the stop and before the next start are not followed */
+    Stop();
+    start = actual_position;
+    Pulses(100);
+    Stepper_TimeTick();
+    CHECK(actual_position == start, "stopped: moved by %ld", (long)(actual_position - start));
+    Start(1);
+    Stepper_TimeTick();
+    CHECK(actual_position == start, "restart: moved by %ld", (long)(actual_position - start));
+    Stop();
+}
+#else
+/* Full-step pulses spread over their period */
+static void Interpolated(void)
+{
+    stepper_position_t start;
+    uint32_t           ticks;
+    uint32_t           step_max = 0;
+    int32_t            ahead_max = 0;
+    uint32_t           reversals = 0;
+
+    Direction(false);
+    Start(K_MODE);
+    start = actual_position;
+
+    /* A pulse every 40 ticks, slower than one sub-step per tick, reversing every 10 pulses */
+    for(ticks = 0; ticks < 4000; ticks++)
+    {
+        stepper_position_t before = actual_position;
+        int32_t            target;
+        int32_t            ahead;
+
+        if((ticks % 400) == 395)
+        {
+            Direction(!(DIR_PORT.IN & DIR_PIN_bm));
+            reversals++;
+        }
+        if(((ticks % 40) == 20) && (ticks < 3600))
+            Pulses(1);
+        Stepper_TimeTick();
+
+        /* A moving motor never goes beyond the commanded position */
+        target = start + (int32_t)K_MODE * commanded;
+        if(actual_position != before)
+        {
+            ahead = (actual_position < before) ? (target - actual_position) : (actual_position - target);
+            if(ahead > ahead_max)
+                ahead_max = ahead;
+        }
+        if((uint32_t)labs(actual_position - before) > step_max)
+            step_max = (uint32_t)labs(actual_position - before);
+    }
+    printf("interpolated: %ld pulses, %lu reversals, motor at %ld sub-steps, %lu sub-steps per tick at most\n", (long)commanded,
+           (unsigned long)reversals, (long)(actual_position - start), (unsigned long)step_max);
+    CHECK(actual_position == start + (int32_t)K_MODE * commanded, "interpolated: position %ld for %ld", (long)(actual_position - start), (long)commanded);
+    CHECK(ahead_max <= 0, "interpolated: %ld sub-steps beyond the commanded position", (long)ahead_max);
+    CHECK(step_max <= 4, "interpolated: %lu sub-steps in a tick", (unsigned long)step_max);
+
+    /* A reversal within a tick, then a burst faster than the interpolation: applied at once */
+    Direction(false);
+    Pulses(2);
+    Direction(true);
+    Pulses(5);
+    for(ticks = 0; ticks < STEP_DIR_PERIOD_MAX + 10; ticks++)
+        Stepper_TimeTick();
+    CHECK(actual_position == start + (int32_t)K_MODE * commanded, "reversal: position %ld for %ld", (long)(actual_position - start), (long)commanded);
+    Pulses(1000);
+    Stepper_TimeTick();
+    CHECK(labs(actual_position - (start + (int32_t)K_MODE * commanded)) <= 2 * K_MODE, "burst: %ld sub-steps behind",
+          labs(actual_position - (start + (int32_t)K_MODE * commanded)));
+    for(ticks = 0; ticks < STEP_DIR_PERIOD_MAX + 10; ticks++)
+        Stepper_TimeTick();
+    CHECK(actual_position == start + (int32_t)K_MODE * commanded, "burst: position %ld for %ld", (long)(actual_position - start), (long)commanded);
+    Stop();
+}
+#endif /* STEP_DIR_INTERPOLATE */
+
+int main(void)
+{
+    Stepper_Init();
+    Stepper_VBusSet(12000);
+    StepDir_Initialize();
+    CHECK((DIR_PINCTRL & PORT_ISC_gm) == PORT_ISC_BOTHEDGES_gc, "DIR interrupt not on both edges");
+    CHECK(CPUINT.LVL1VEC == DIR_PORT_vect_num, "DIR interrupt not at the high priority level");
+
+#if (STEP_DIR_INTERPOLATE == false)
+    Direct();
+    return Mock_Result("test_step_dir");
+#else
+    Interpolated();
+    return Mock_Result("test_step_dir_interpolate");
+#endif
+}
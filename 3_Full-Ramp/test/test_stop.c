@@ -0,0 +1,123 @@
+/* Quick stop and abort (user-018): the quick stop decelerates with QUICK_STOP_DEC from the next tick and releases
+ * the coils within speed / QUICK_STOP_DEC + 1 ticks, the abort releases them at the next PWM update. Both report
+ * the position reached and the latency from the request. */
+#include "stepper.c"
+#include "mock.h"
+
+
+#define SPEED           SPEED_LIMIT(UINT16_MAX)
+#define ACCELERATION    2000
+#define REQUEST_CLOCK   300             /* TCE0 counter when the stop is requested, inside the PWM period */
+
+static stepper_position_t stop_position;
+static uint16_t           stop_calls;
+
+static void StopReport(stepper_position_t position)
+{
+    stop_position = position;
+    stop_calls++;
+}
+
+static bool CoilsReleased(void)
+{
+    return (mock_compare[0] | mock_compare[1] | mock_compare[2] | mock_compare[3]) == DRIVE_ZERO;
+}
+
+/* Requests the quick stop inside a PWM period and checks the deceleration to standstill */
+static void QuickStopCheck(const char *name)
+{
+    uint32_t ticks = 0;
+    uint32_t start_speed = actual_speed;
+    uint32_t previous_speed = actual_speed;
+    uint32_t ticks_max = start_speed / QUICK_STOP_DEC + 1;
+
+    stop_calls = 0;
+    mock_counter = REQUEST_CLOCK;
+    Stepper_QuickStop();
+    mock_counter = 0;
+    while(CoilsReleased() == false && (ticks < 100000))
+    {
+        Stepper_TimeTick();
+        ticks++;
+        CHECK((actual_speed + QUICK_STOP_DEC >= previous_speed) || (actual_speed == 0), "%s: tick %lu speed %u -> %u", name, (unsigned long)ticks, previous_speed, actual_speed);
+        if(ticks == 1)
+        {
+            CHECK(actual_speed < previous_speed, "%s: first tick not decelerated", name);
+        }
+        previous_speed = actual_speed;
+    }
+    printf("%s: from speed %u, coils released after %lu ticks, latency %u clocks\n", name, start_speed, (unsigned long)ticks, Stepper_StopLatencyGet());
+    CHECK(ticks <= ticks_max, "%s: %lu ticks, more than %lu", name, (unsigned long)ticks, (unsigned long)ticks_max);
+    CHECK(Stepper_StopLatencyGet() == TICK_CLOCKS - REQUEST_CLOCK, "%s: latency %u", name, Stepper_StopLatencyGet());
+    CHECK(Stepper_IsBusy() == false, "%s: still busy", name);
+    CHECK((stop_calls == 1) && (stop_position == Stepper_GetPosition()), "%s: %u reports, position %ld instead of %ld", name, stop_calls, (long)stop_position, (long)Stepper_GetPosition());
+}
+
+int main(void)
+{
+    uint16_t           tick;
+    stepper_position_t position;
+
+    Stepper_Init();
+    Stepper_VBusSet(12000);
+    Stepper_StopCallbackRegister(StopReport);
+
+    /* Velocity mode at the speed limit, in both directions */
+    Stepper_VelocitySet(false, SPEED, ACCELERATION, ACCELERATION, 12000);
+    for(tick = 0; tick < 100; tick++)
+        Stepper_TimeTick();
+    CHECK(actual_speed == SPEED, "speed %u", actual_speed);
+    QuickStopCheck("velocity CW");
+    Stepper_VelocitySet(true, SPEED, ACCELERATION, ACCELERATION, 12000);
+    for(tick = 0; tick < 100; tick++)
+        Stepper_TimeTick();
+    QuickStopCheck("velocity CCW");
+
+    /* Queued movements: the queue is dropped */
+    Stepper_MoveStart(1000000, ACCELERATION, ACCELERATION, SPEED, 12000);
+    Stepper_MoveStart(1000000, ACCELERATION, ACCELERATION, SPEED, 12000);
+    for(tick = 0; tick < 3000; tick++)
+        Stepper_TimeTick();
+    CHECK(actual_speed == SPEED, "speed %u", actual_speed);
+    QuickStopCheck("movement");
+
+    /* The velocity mode is ignored until standstill */
+    Stepper_VelocitySet(false, SPEED, ACCELERATION, ACCELERATION, 12000);
+    for(tick = 0; tick < 100; tick++)
+        Stepper_TimeTick();
+    mock_counter = REQUEST_CLOCK;
+    Stepper_QuickStop();
+    mock_counter = 0;
+    Stepper_TimeTick();
+    Stepper_VelocitySet(true, SPEED, ACCELERATION, ACCELERATION, 12000);
+    for(tick = 0; (tick < 1000) && Stepper_IsBusy(); tick++)
+        Stepper_TimeTick();
+    CHECK(Stepper_IsBusy() == false, "velocity mode restarted during the quick stop");
+
+    /* Abort: zero compares in the call, applied by TCE0 at the next PWM update */
+    stop_calls = 0;
+    Stepper_VelocitySet(false, SPEED, ACCELERATION, ACCELERATION, 12000);
+    for(tick = 0; tick < 100; tick++)
+        Stepper_TimeTick();
+    mock_counter = REQUEST_CLOCK;
+    position = Stepper_Abort();
+    mock_counter = 0;
+    CHECK(CoilsReleased(), "abort: coils driven");
+    CHECK(Stepper_IsBusy() == false, "abort: still busy");
+    CHECK(Stepper_StopLatencyGet() == TICK_CLOCKS - REQUEST_CLOCK, "abort: latency %u", Stepper_StopLatencyGet());
+    CHECK((stop_calls == 1) && (stop_position == position), "abort: %u reports, position %ld instead of %ld", stop_calls, (long)stop_position, (long)position);
+    Stepper_TimeTick();
+    CHECK(Stepper_GetPosition() == position, "abort: moved on to %ld", (long)Stepper_GetPosition());
+
+    /* From another interrupt, while the tick runs in its own */
+    stop_calls = 0;
+    Mock_TickerStart(Stepper_TimeTick);
+    Stepper_VelocitySet(true, SPEED, ACCELERATION, ACCELERATION, 12000);
+    while(Stepper_IsBusy() && (mock_ticks < 200));
+    Stepper_QuickStop();
+    while(Stepper_IsBusy());
+    Mock_TickerStop();
+    CHECK((stop_calls == 1) && (stop_position == Stepper_GetPosition()), "interrupt: %u reports, position %ld instead of %ld", stop_calls, (long)stop_position, (long)Stepper_GetPosition());
+
+    return Mock_Result("test_stop");
+}
@@ -0,0 +1,108 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "coil_pwm.h"
+
+
+/* Last values, written by the stepper. coil_changed tells CoilPwm_Update to compute the duty cycles again. */
+static uint16_t          coil_amplitude;
+static uint16_t          coil_channel[4];
+static bool              coil_changed;
+
+/* Duty cycles computed by CoilPwm_Update, in the register format, waiting for the next period boundary */
+static volatile uint16_t coil_duty[4];
+
+/* Register value of a duty cycle: in the 8-bit PWM mode the low byte holds the period and the high byte the duty
+ * cycle, written as one 16-bit value */
+#define COIL_PWM_CMP(duty)      (((uint16_t)(duty) << 8) | (COIL_PWM_PERIOD - 1))
+
+static void DutyWrite(void)
+{
+    TCF0.CMP0 = coil_duty[0];
+    TCF0.CMP1 = coil_duty[1];
+    TCB0.CCMP = coil_duty[2];
+    TCB1.CCMP = coil_duty[3];
+}
+
+void CoilPwm_Initialize(void)
+{
+    coil_amplitude = 0;
+    coil_channel[0] = coil_channel[1] = coil_channel[2] = coil_channel[3] = 0;
+    coil_changed = false;
+    coil_duty[0] = coil_duty[1] = coil_duty[2] = coil_duty[3] = COIL_PWM_CMP(0);
+
+    PORTMUX.TCFROUTEA = COIL_PWM_TCF_ROUTE;
+    PORTMUX.TCBROUTEA = COIL_PWM_TCB_ROUTE;
+    DutyWrite();
+
+    TCB0.CTRLB = TCB_CCMPEN_bm | TCB_CNTMODE_PWM8_gc;
+    TCB1.CTRLB = TCB_CCMPEN_bm | TCB_CNTMODE_PWM8_gc;
+    TCF0.CTRLB = TCF_CLKSEL_CLKPER_gc | TCF_WGMODE_PWM8_gc;
+    TCF0.CTRLC = TCF_WO0EN_bm | TCF_WO1EN_bm;
+    TCB0.INTCTRL = 0;
+
+    TCB0.CTRLA = TCB_CLKSEL_DIV2_gc | TCB_ENABLE_bm;
+    TCB1.CTRLA = TCB_CLKSEL_DIV2_gc | TCB_ENABLE_bm;
+    TCF0.CTRLA = TCF_PRESC_DIV2_gc | TCF_ENABLE_bm;
+
+    USE_COIL_PWM_PINS();
+}
+
+void CoilPwm_AmplitudeSet(uint16_t value)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        coil_amplitude = value;
+        coil_changed = true;
+    }
+}
+
+void CoilPwm_CompareAllChannelsBufferedSet(uint16_t value0, uint16_t value1, uint16_t value2, uint16_t value3)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        coil_channel[0] = value0;
+        coil_channel[1] = value1;
+        coil_channel[2] = value2;
+        coil_channel[3] = value3;
+        coil_changed = true;
+    }
+}
+
+void CoilPwm_Update(void)
+{
+    uint8_t scale;
+    uint8_t k;
+
+    if(coil_changed == false)
+        return;
+    coil_changed = false;
+
+    /* The amplitude becomes the full duty cycle in timer clocks, then each channel takes its 8 upper bits, both rounded:
+     * one multiply for the amplitude and four 8x8 ones instead of two 32-bit ones per channel, within two timer clocks */
+    scale = (uint8_t)(((uint32_t)coil_amplitude * COIL_PWM_PERIOD + 16384) >> 15);
+    for(k = 0; k < 4; k++)
+    {
+        uint16_t channel = (coil_channel[k] >= 32704) ? 255 : ((coil_channel[k] + 64) >> 7);
+
+        coil_duty[k] = COIL_PWM_CMP((channel * scale + 128) >> 8);
+    }
+
+    /* Applied by the next period boundary of TCB0 */
+    TCB0.INTFLAGS = TCB_CAPT_bm;
+    TCB0.INTCTRL = TCB_CAPT_bm;
+}
+
+/* In the 8-bit PWM mode the CAPT flag rises when the counter wraps, at the start of a period. The three timers share the
+ * clock and start together, so the other two are at the start of their period too. */
+ISR(TCB0_INT_vect)
+{
+    TCB0.INTFLAGS = TCB_CAPT_bm;
+    if((uint8_t)TCB0.CNT > COIL_PWM_GUARD)
+        return;
+
+    DutyWrite();
+    TCB0.INTCTRL = 0;
+}
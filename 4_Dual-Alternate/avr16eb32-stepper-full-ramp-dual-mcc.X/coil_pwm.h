@@ -0,0 +1,41 @@
+#ifndef COIL_PWM_H
+#define COIL_PWM_H
+
+
+#include <stdint.h>
+#include <avr/io.h>
+
+
+/* USER DEFINE CONFIGS*/
+/* Coil PWM outputs of the second power board in the SIMULTANEOUS mode: TCF0 WO0, TCF0 WO1, TCB0 WO and TCB1 WO
+ * drive the channels a, b, c and d. The routes must not use the TCE0/WEX0 pins of the first power board.
+ * TCF0 ALT2 is on PF4/PF5 and TCB0/TCB1 ALT1 on PC0/PC3, so the VBUS inputs move to PF2/PF3, see stepper.h.
+ * Hardware prerequisite: the VBUS dividers of the two power boards must be wired to PF2 and PF3 instead of PF4 and
+ * PC0, where the adapter connects them, otherwise a coil output drives the divider. */
+#define COIL_PWM_TCF_ROUTE      PORTMUX_TCF0_ALT2_gc
+#define COIL_PWM_TCB_ROUTE      (PORTMUX_TCB0_ALT1_gc | PORTMUX_TCB1_ALT1_gc)
+
+/* Sets the pins of the selected routes as outputs */
+#define USE_COIL_PWM_PINS()     ({PORTF.DIRSET = PIN4_bm | PIN5_bm; PORTC.DIRSET = PIN0_bm | PIN3_bm;})
+
+
+/* 8-bit PWM period in timer clocks. The timers run from the peripheral clock divided by 2: 10 MHz / 250 = 40 kHz. */
+#define COIL_PWM_PERIOD         250
+
+/* The new duty cycles are written at the start of a PWM period, from the TCB0 interrupt. When it comes later than this
+ * many timer clocks into the period, a duty cycle could be written below the counter and its pulse would last the whole
+ * period, so the write waits for the next period. */
+#define COIL_PWM_GUARD          40
+
+
+/* Function Prototypes*/
+void    CoilPwm_Initialize(void);
+
+/* Same units as TCE0_AmplitudeSet and TCE0_CompareAllChannelsBufferedSet: U.Q.1.15, the duty cycles are scaled by the
+   amplitude in software. They only record the values: CoilPwm_Update, called once at the end of the tick, computes the
+   duty cycles when one of them changed, and they are applied together at the start of the next PWM period. */
+void    CoilPwm_AmplitudeSet(uint16_t);
+void    CoilPwm_CompareAllChannelsBufferedSet(uint16_t, uint16_t, uint16_t, uint16_t);
+void    CoilPwm_Update(void);
+
+#endif /*  COIL_PWM_H  */
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include "mcc_generated_files/system/system.h"
 #include "util/delay.h"
+#include "util/atomic.h"
 #include "stepper.h"
 
 /*  Function that returns the voltage expressed in mV */
@@ -46,26 +47,57 @@ uint16_t Get_VBus(adc_0_channel_t channel)
     return vbus_mv;
 }
 
-stepper_position_t MainMove(stepper_position_t position, stepper_position_t displacement, uint16_t speed, adc_0_channel_t channel)
+/* The two motors, each one with its own position and electrical angle */
+static stepper_axis_t stepper_a = STEPPER_AXIS(STEPPER_ROUTE_A, &STEPPER_PWM_TCE0, VBUS_ADC_A, R, I_OUT, KV);
+static stepper_axis_t stepper_b = STEPPER_AXIS(STEPPER_ROUTE_B, STEPPER_PWM_B, VBUS_ADC_B, R, I_OUT, KV);
+
+stepper_position_t MainMove(stepper_axis_t *axis, stepper_position_t displacement, uint16_t speed)
 {
     uint16_t acc   = DEGPS_TO_U16(0.3);
     uint16_t decc  = DEGPS_TO_U16(0.3);
     uint16_t vbus;
+    stepper_position_t position;
 
-    vbus = Get_VBus(channel);
+    vbus = Get_VBus(axis->vbus_channel);
+    position = Stepper_GetPosition(axis);
     printf("\n\rSupply voltage: \t%.2f V", 0.001*(float)vbus);
     printf("\n\rInitial position:\t%.2f steps / %ld sub-steps", SUBSTEPS_TO_STEPS(position), position);
     printf("\n\rMoving with speed:\t%.3f degrees/second", U16_TO_DEGPS(speed));
-    position = Stepper_Move(position, displacement, acc, decc, speed, vbus);
+    position = Stepper_Move(axis, displacement, acc, decc, speed, vbus);
     printf("\n\rFinal position: \t%.2f steps / %ld sub-steps", SUBSTEPS_TO_STEPS(position), position);
+    if(USART0_TxDroppedGet() != 0)
+        printf("\n\rLog bytes dropped:\t%u", USART0_TxDroppedGet());
     printf("\n\r");
     return position;
 }
 
-int main(void)
+#if (DUAL_MODE == SIMULTANEOUS)
+/* Starts both motors in the same tick and waits until both complete their movements */
+void MainMoveBoth(stepper_position_t displacement_a, stepper_position_t displacement_b, uint16_t speed)
 {
-    stepper_position_t stepper_position = 0;
+    uint16_t acc   = DEGPS_TO_U16(0.3);
+    uint16_t decc  = DEGPS_TO_U16(0.3);
+    uint16_t vbus_a;
+    uint16_t vbus_b;
 
+    vbus_a = Get_VBus(stepper_a.vbus_channel);
+    vbus_b = Get_VBus(stepper_b.vbus_channel);
+    printf("\n\rSupply voltage: \t%.2f V / %.2f V", 0.001*(float)vbus_a, 0.001*(float)vbus_b);
+    printf("\n\rMoving with speed:\t%.3f degrees/second", U16_TO_DEGPS(speed));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        Stepper_MoveStart(&stepper_a, displacement_a, acc, decc, speed, vbus_a);
+        Stepper_MoveStart(&stepper_b, displacement_b, acc, decc, speed, vbus_b);
+    }
+    while(Stepper_IsBusy(&stepper_a) || Stepper_IsBusy(&stepper_b));
+    printf("\n\rFinal position A:\t%.2f steps / %ld sub-steps", SUBSTEPS_TO_STEPS(Stepper_GetPosition(&stepper_a)), Stepper_GetPosition(&stepper_a));
+    printf("\n\rFinal position B:\t%.2f steps / %ld sub-steps", SUBSTEPS_TO_STEPS(Stepper_GetPosition(&stepper_b)), Stepper_GetPosition(&stepper_b));
+    printf("\n\r");
+}
+#endif /* DUAL_MODE */
+
+int main(void)
+{
     /* System initialize */
     SYSTEM_Initialize();
 
@@ -73,53 +105,68 @@ int main(void)
     TCE0_OverflowCallbackRegister(Stepper_TimeTick);
 
     Stepper_Init();
+    Stepper_AxisAdd(&stepper_a);
+    Stepper_AxisAdd(&stepper_b);
     
     _delay_ms(2000);
     printf("\n\r-----------------------------------------------");
     printf("\n\rStepping Mode: %s, 1 step = %d sub-steps", STRING, K_MODE);
     printf("\n\r");
 
+#if (DUAL_MODE == SIMULTANEOUS)
+    while(1)
+    {
+        printf("\n\rUsing Stepper A and Stepper B");
+
+        MainMoveBoth(STEPS_TO_SUBSTEPS(400), -STEPS_TO_SUBSTEPS(200), SPEED_LIMIT(DEGPS_TO_U16(360)));
+        _delay_ms(500);
+
+        MainMoveBoth(-STEPS_TO_SUBSTEPS(400), STEPS_TO_SUBSTEPS(200), SPEED_LIMIT(DEGPS_TO_U16(180)));
+        _delay_ms(500);
+
+        /* Straight line back to the start: both motors start and stop together */
+        printf("\n\rLine to the start position");
+        if(Stepper_MoveXY(&stepper_a, &stepper_b, -Stepper_GetPosition(&stepper_a), -Stepper_GetPosition(&stepper_b),
+                          DEGPS_TO_U16(0.3), DEGPS_TO_U16(0.3), SPEED_LIMIT(DEGPS_TO_U16(360)), Get_VBus(stepper_a.vbus_channel)) == false)
+        {
+            printf("\n\rLine refused, the motors share their outputs");
+        }
+        printf("\n\rFinal position A:\t%ld sub-steps / B:\t%ld sub-steps\n\r", Stepper_GetPosition(&stepper_a), Stepper_GetPosition(&stepper_b));
+        _delay_ms(500);
+    }
+#else
     while(1)
     {
         stepper_position_t sub_steps;
         uint16_t           speed;
         printf("\n\rUsing Stepper A");
-        USE_STEPPER_A();
         
         sub_steps = STEPS_TO_SUBSTEPS(400);        /* Positive: CW, Negative: CCW */
         speed = SPEED_LIMIT(DEGPS_TO_U16(360));    /* Degrees per second */
 
-        stepper_position = MainMove(stepper_position,
-                                    sub_steps,
-                                    speed, VBUS_ADC_A);
+        MainMove(&stepper_a, sub_steps, speed);
         _delay_ms(500);
         
         sub_steps = -STEPS_TO_SUBSTEPS(200);       /* Positive: CW, Negative: CCW */
         speed = SPEED_LIMIT(DEGPS_TO_U16(180));    /* Degrees per second */
 
-        stepper_position = MainMove(stepper_position,
-                                    sub_steps,
-                                    speed, VBUS_ADC_A);
+        MainMove(&stepper_a, sub_steps, speed);
         _delay_ms(500);
         
         printf("\n\rUsing Stepper B");
-        USE_STEPPER_B();
         
         sub_steps = STEPS_TO_SUBSTEPS(400);        /* Positive: CW, Negative: CCW */
         speed = SPEED_LIMIT(DEGPS_TO_U16(360));    /* Degrees per second */
 
-        stepper_position = MainMove(stepper_position,
-                                    sub_steps,
-                                    speed, VBUS_ADC_B);
+        MainMove(&stepper_b, sub_steps, speed);
         _delay_ms(500);
         
         sub_steps = -STEPS_TO_SUBSTEPS(200);       /* Positive: CW, Negative: CCW */
         speed = SPEED_LIMIT(DEGPS_TO_U16(180));    /* Degrees per second */
 
-        stepper_position = MainMove(stepper_position,
-                                    sub_steps,
-                                    speed, VBUS_ADC_B);
+        MainMove(&stepper_b, sub_steps, speed);
         _delay_ms(500);
     }
+#endif /* DUAL_MODE */
 }
 
@@ -41,6 +41,7 @@
   Section: Macro Declarations
 */
 
+#define USART0_TX_BUFFER_MASK (USART0_TX_BUFFER_SIZE - 1U)
 
 
 /**
@@ -79,6 +80,13 @@ const uart_drv_interface_t UART0 = {
 */
 static volatile usart0_status_t usart0RxLastError;
 
+/* Transmit ring buffer, filled by USART0_Write and drained by the Data Register Empty interrupt */
+static volatile uint8_t usart0TxHead = 0;
+static volatile uint8_t usart0TxTail = 0;
+static volatile uint8_t usart0TxBuffer[USART0_TX_BUFFER_SIZE];
+static volatile uint16_t usart0TxBufferRemaining;
+static volatile uint16_t usart0TxDropped;
+
 /**
   Section: USART0 APIs
 */
@@ -100,7 +108,6 @@ static void USART0_DefaultParityErrorCallback(void);
 
 int USART0_printCHAR(char character, FILE *stream)
 {
-    while(!(USART0_IsTxReady()));
     USART0_Write(character);
     return 0;
 }
@@ -111,7 +118,6 @@ FILE USART0_stream = FDEV_SETUP_STREAM(USART0_printCHAR, NULL, _FDEV_SETUP_WRITE
 
 int putchar (int outChar)
 {
-    while(!(USART0_IsTxReady()));
     USART0_Write(outChar);
     return outChar;
 }
@@ -125,6 +131,7 @@ void USART0_Initialize(void)
     USART0.BAUD = (uint16_t)USART0_BAUD_RATE(115200);
 	
     // ABEIE disabled; DREIE disabled; LBME disabled; RS485 DISABLE; RXCIE disabled; RXSIE disabled; TXCIE disabled; 
+    // DREIE is enabled by USART0_Write while the transmit buffer holds data
     USART0.CTRLA = 0x0;
 	
     // MPCM disabled; ODME disabled; RXEN enabled; RXMODE NORMAL; SFDEN disabled; TXEN enabled; 
@@ -149,6 +156,10 @@ void USART0_Initialize(void)
     USART0_OverrunErrorCallbackRegister(USART0_DefaultOverrunErrorCallback);
     USART0_ParityErrorCallbackRegister(USART0_DefaultParityErrorCallback);
     usart0RxLastError.status = 0;  
+    usart0TxHead = 0;
+    usart0TxTail = 0;
+    usart0TxBufferRemaining = USART0_TX_BUFFER_SIZE;
+    usart0TxDropped = 0;
 #if defined(__GNUC__)
     stdout = &USART0_stream;
 #endif
@@ -240,12 +251,17 @@ bool USART0_IsRxReady(void)
 
 bool USART0_IsTxReady(void)
 {
-    return (bool)(USART0.STATUS & USART_DREIF_bm);
+    return (usart0TxBufferRemaining != 0U);
 }
 
 bool USART0_IsTxDone(void)
 {
-    return (bool)(USART0.STATUS & USART_TXCIF_bm);
+    return (usart0TxBufferRemaining == USART0_TX_BUFFER_SIZE) && (bool)(USART0.STATUS & USART_TXCIF_bm);
+}
+
+uint16_t USART0_TxDroppedGet(void)
+{
+    return usart0TxDropped;
 }
 
 size_t USART0_ErrorGet(void)
@@ -287,7 +303,53 @@ uint8_t USART0_Read(void)
 
 void USART0_Write(uint8_t txData)
 {
-    USART0.TXDATAL = txData;    // Write the data byte to the USART.
+    if(0U == usart0TxBufferRemaining)
+    {
+#if (USART0_TX_OVERFLOW_POLICY == USART0_TX_OVERFLOW_BLOCK)
+        while(0U == usart0TxBufferRemaining)
+        {
+            // With the interrupts disabled the buffer is drained here
+            if(((SREG & CPU_I_bm) == 0U) && (USART0.STATUS & USART_DREIF_bm))
+            {
+                USART0_TransmitISR();
+            }
+        }
+#else
+        if(usart0TxDropped != UINT16_MAX)
+        {
+            usart0TxDropped++;
+        }
+        return;
+#endif
+    }
+
+    usart0TxBuffer[usart0TxHead] = txData;
+    usart0TxHead = (usart0TxHead + 1U) & USART0_TX_BUFFER_MASK;
+
+    // The interrupt is disabled while the shared counter is updated
+    USART0.CTRLA &= ~(USART_DREIE_bm);
+    usart0TxBufferRemaining--;
+    USART0.CTRLA |= USART_DREIE_bm;
+}
+
+void USART0_TransmitISR(void)
+{
+    if(USART0_TX_BUFFER_SIZE != usart0TxBufferRemaining)
+    {
+        USART0.TXDATAL = usart0TxBuffer[usart0TxTail];
+        usart0TxTail = (usart0TxTail + 1U) & USART0_TX_BUFFER_MASK;
+        usart0TxBufferRemaining++;
+    }
+    else
+    {
+        // Nothing left to send
+        USART0.CTRLA &= ~(USART_DREIE_bm);
+    }
+}
+
+ISR(USART0_DRE_vect)
+{
+    USART0_TransmitISR();
 }
 static void USART0_DefaultFramingErrorCallback(void)
 {
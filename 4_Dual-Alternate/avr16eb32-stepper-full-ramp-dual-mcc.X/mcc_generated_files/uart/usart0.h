@@ -52,6 +52,14 @@
 /* Normal Mode, Baud register value */
 #define USART0_BAUD_RATE(BAUD_RATE) (((float)20000000 * 64 / (16 * (float)BAUD_RATE)) + 0.5)
 
+/* Transmit buffer size in bytes, power of two up to 256 */
+#define USART0_TX_BUFFER_SIZE (256U)
+
+/* Behavior of USART0_Write when the transmit buffer is full */
+#define USART0_TX_OVERFLOW_DROP     0   /* The byte is discarded and counted, the caller never waits */
+#define USART0_TX_OVERFLOW_BLOCK    1   /* The caller waits until the buffer has space */
+#define USART0_TX_OVERFLOW_POLICY   USART0_TX_OVERFLOW_DROP
+
 #define UART0_interface UART0
 
 
@@ -229,8 +237,8 @@ bool USART0_IsRxReady(void);
  * @ingroup usart0
  * @brief This function checks if USART0 transmitter is ready to accept a data byte.
  * @param None.
- * @retval true if USART0 transmitter FIFO has atleast 1 byte space
- * @retval false if USART0 transmitter FIFO is full
+ * @retval true if USART0 transmit buffer has atleast 1 byte space
+ * @retval false if USART0 transmit buffer is full
  */
 bool USART0_IsTxReady(void);
 
@@ -264,14 +272,31 @@ uint8_t USART0_Read(void);
 
 /**
  * @ingroup usart0
- * @brief This function writes a byte of data to the transmitter FIFO register.
- * @pre The transfer status should be checked to see if the transmitter is ready to accept a byte
- *      before calling this function. USART0_IsTxReady() should be checked in if() before calling this API.
- * @param txData  - Data byte to write to the TX FIFO.
+ * @brief This function writes a byte of data to the transmit buffer. The byte is sent by the
+ *        Data Register Empty interrupt. If the buffer is full, the byte is dropped or the function waits,
+ *        depending on USART0_TX_OVERFLOW_POLICY.
+ * @param txData  - Data byte to write to the transmit buffer.
  * @return None.
  */
 void USART0_Write(uint8_t txData);
 
+/**
+ * @ingroup usart0
+ * @brief This function sends the next byte of the transmit buffer. Called from the Data Register Empty interrupt.
+ * @param None.
+ * @return None.
+ */
+void USART0_TransmitISR(void);
+
+/**
+ * @ingroup usart0
+ * @brief This function returns the number of bytes dropped because the transmit buffer was full.
+ *        The count saturates at UINT16_MAX.
+ * @param None.
+ * @return Number of dropped bytes since initialization.
+ */
+uint16_t USART0_TxDroppedGet(void);
+
 /**
  * @ingroup usart0
  * @brief This API registers the function to be called upon USART0 framing error.
@@ -1,258 +1,282 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <util/atomic.h>
 #include "mcc_generated_files/timer/tce0.h"
 #include "stepper.h"
+#if (DUAL_MODE == SIMULTANEOUS)
+#include "coil_pwm.h"
+#endif /* DUAL_MODE */
 
 
-#define V_OUT                                   (R)*(I_OUT)  /* Output Voltage [mV] */
-#define K_COMP                                  (1000000000.0 * (float)KV/(float)K_MODE)
+const stepper_pwm_t STEPPER_PWM_TCE0 = { TCE0_AmplitudeSet, TCE0_CompareAllChannelsBufferedSet };
 
+#if (DUAL_MODE == SIMULTANEOUS)
+const stepper_pwm_t STEPPER_PWM_COIL = { CoilPwm_AmplitudeSet, CoilPwm_CompareAllChannelsBufferedSet };
+#endif /* DUAL_MODE */
 
-/* Flag set by interrupt */
-static volatile bool     time_flag;
+/* Motors advanced by Stepper_TimeTick */
+static stepper_axis_t   *axes[STEPPER_AXES_MAX];
+static uint8_t           axes_count;
+
+/* Coil drive lookup
+ * The electrical angle is a single index with 4 * COIL_RES entries per electrical period (4 full-steps).
+ * In every quarter of the period one channel is driven with coil_table[s] (sine) and another one with
+ * coil_table[COIL_COS_BASE - s] (cosine), s being the position inside the quarter. The other two channels are zero. */
+#if STEPPING_MODE == FULL_STEP
+#define COIL_RES        1
+#define COIL_COS_BASE   0
+static const uint16_t coil_table[COIL_RES] = { DRIVE_FULL };
+#endif /* STEPPING_MODE == FULL_STEP */
+
+#if STEPPING_MODE == HALF_STEP
+#define COIL_RES        2
+#define COIL_COS_BASE   2
+static const uint16_t coil_table[COIL_RES + 1] = { DRIVE_ZERO, DRIVE_HALF, DRIVE_FULL };
+#endif /* STEPPING_MODE == HALF_STEP */
 
 #if STEPPING_MODE == MICRO_STEP
-static const uint16_t sine_lookup_table[32] = 
-{
-    AMP_TO_U16(0.024541229),
-    AMP_TO_U16(0.073564564),
-    AMP_TO_U16(0.122410675),
-    AMP_TO_U16(0.170961889),
-    AMP_TO_U16(0.21910124),
-    AMP_TO_U16(0.266712757),
-    AMP_TO_U16(0.31368174),
-    AMP_TO_U16(0.359895037),
-    AMP_TO_U16(0.405241314),
-    AMP_TO_U16(0.44961133),
-    AMP_TO_U16(0.492898192),
-    AMP_TO_U16(0.53499762),
-    AMP_TO_U16(0.575808191),
-    AMP_TO_U16(0.615231591),
-    AMP_TO_U16(0.653172843),
-    AMP_TO_U16(0.689540545),
-    AMP_TO_U16(0.724247083),
-    AMP_TO_U16(0.757208847),
-    AMP_TO_U16(0.788346428),
-    AMP_TO_U16(0.817584813),
-    AMP_TO_U16(0.844853565),
-    AMP_TO_U16(0.870086991),
-    AMP_TO_U16(0.893224301),
-    AMP_TO_U16(0.914209756),
-    AMP_TO_U16(0.932992799),
-    AMP_TO_U16(0.949528181),
-    AMP_TO_U16(0.963776066),
-    AMP_TO_U16(0.97570213),
-    AMP_TO_U16(0.985277642),
-    AMP_TO_U16(0.992479535),
-    AMP_TO_U16(0.997290457),
-    AMP_TO_U16(0.999698819)
-};
-#else /* STEPPING_MODE */
-typedef enum
-{
-    CW_STEP_0 = 0,
-    CW_STEP_45 = 1,
-    CW_STEP_90 = 2,
-    CW_STEP_135 = 3,
-    CW_STEP_180 = 4,
-    CW_STEP_225 = 5,
-    CW_STEP_270 = 6,
-    CW_STEP_315 = 7,
-    
-    
-    CCW_STEP_0 = 8,
-    CCW_STEP_45 = 9,
-    CCW_STEP_90 = 10,
-    CCW_STEP_135 = 11,
-    CCW_STEP_180 = 12,
-    CCW_STEP_225 = 13,
-    CCW_STEP_270 = 14,
-    CCW_STEP_315 = 15
-} step_t;
-#endif /* STEPPING_MODE  */
-
-/* Doesn't reset the counter */
-#define NO_CMD      false
-
-/* Reset the counter */
-#define RESET_CMD   true
+/* K_MODE entries of sin((i + 0.5) * 90 / K_MODE degrees), generated at compile time. K_MODE must be a power of two up to 256. */
+#define COIL_RES        K_MODE
+#define COIL_COS_BASE   (COIL_RES - 1)
+
+#define SINE_PI                                 3.14159265358979
+#define SINE_ENTRY(i)                           AMP_TO_U16(__builtin_sin(((i) + 0.5) * SINE_PI / (2.0 * COIL_RES))),
+#define SINE_REP1(i)                            SINE_ENTRY(i)
+#define SINE_REP2(i)                            SINE_REP1(i)   SINE_REP1((i) + 1)
+#define SINE_REP4(i)                            SINE_REP2(i)   SINE_REP2((i) + 2)
+#define SINE_REP8(i)                            SINE_REP4(i)   SINE_REP4((i) + 4)
+#define SINE_REP16(i)                           SINE_REP8(i)   SINE_REP8((i) + 8)
+#define SINE_REP32(i)                           SINE_REP16(i)  SINE_REP16((i) + 16)
+#define SINE_REP64(i)                           SINE_REP32(i)  SINE_REP32((i) + 32)
+#define SINE_REP128(i)                          SINE_REP64(i)  SINE_REP64((i) + 64)
+#define SINE_REP256(i)                          SINE_REP128(i) SINE_REP128((i) + 128)
+#define SINE_TABLE_(n)                          SINE_REP##n(0)
+#define SINE_TABLE(n)                           SINE_TABLE_(n)
+
+static const uint16_t coil_table[COIL_RES] = { SINE_TABLE(K_MODE) };
+#endif /* STEPPING_MODE == MICRO_STEP */
+
+#define COIL_INDEX_MASK                         (4 * COIL_RES - 1)
+
+/* Channels (0: a, 1: b, 2: c, 3: d) driven with the sine and with the cosine in each quarter of the electrical period */
+static const uint8_t sine_channel[4]   = { 3, 0, 2, 1 };
+static const uint8_t cosine_channel[4] = { 1, 3, 0, 2 };
 
 /* This function returns true if the delay for the next step expired */
-static inline bool CheckSteps(bool reset_cmd, uint16_t actual_speed)
+static inline bool CheckSteps(stepper_axis_t *axis)
 {
-    static uint16_t counter = 0;
     uint16_t pre_counter;
-    
-    if(reset_cmd == RESET_CMD)
-    {
-        counter = 0;
-        return false;
-    }
+
+    pre_counter = axis->counter;
+    axis->counter += axis->actual_speed;
+
+    /* This checks for overflow */
+    if(axis->counter < pre_counter)
+        return true;
     else
-    {
-        while(time_flag == false);
-        time_flag = false;
-
-        pre_counter = counter;
-        counter += actual_speed;
-        
-        /* This checks for overflow */
-        if(counter < pre_counter)
-            return true;
-        else
-            return false;
-    }
+        return false;
+}
+
+/* Writes the coil values of the electrical index of the axis */
+static void CoilApply(const stepper_axis_t *axis)
+{
+    uint16_t channel[4] = { DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO };
+    uint8_t  quarter;
+    uint16_t s;
+
+    quarter = (uint8_t)(axis->step / COIL_RES);
+    s = axis->step & (COIL_RES - 1);
+
+    channel[sine_channel[quarter]]   = coil_table[s];
+    channel[cosine_channel[quarter]] = coil_table[COIL_COS_BASE - s];
+
+    axis->pwm->CompareAllChannelsBufferedSet(channel[0], channel[1], channel[2], channel[3]);
 }
 
 /* If parameter direction is True means that motor will spin in CCW */
-static void StepAdvance(bool direction)
+static void StepAdvance(stepper_axis_t *axis, bool direction)
 {  
-    uint16_t a = 0, b = 0, c = 0, d = 0;
+    /* CW: +1, CCW: -1 on the same index, so the electrical angle stays continuous when the direction changes */
+    axis->step = (axis->step + 1 - 2 * (uint16_t)direction) & COIL_INDEX_MASK;
+    CoilApply(axis);
+}
 
-#if STEPPING_MODE == FULL_STEP    
-    static step_t step = 0;
-    /*These masks are correlated with step_t */
-    step &= 7;
-    if(direction) step |= 8;
+static inline void AmplitudeSet(const stepper_axis_t *axis, uint16_t amplitude)
+{
+    if(amplitude > 32768)
+        amplitude = 32768;
+    axis->pwm->AmplitudeSet(amplitude);
+}
 
-    switch(step)
+/* Movement completed. Now the motor is stopped. */
+static void AxisComplete(stepper_axis_t *axis)
+{
+    axis->actual_speed = 0;
+    AmplitudeSet(axis, axis->amplitude);
+
+    /* Release the current through coils */
+#if (RELEASE_IN_IDLE == true)
+    axis->pwm->CompareAllChannelsBufferedSet(DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO);
+#endif /* RELEASE_IN_IDLE */
+    axis->follower = false;
+    axis->busy = false;
+}
+
+/* Advances the minor axis of a line after a sub-step of the major axis */
+static void MinorStep(stepper_axis_t *axis)
+{
+    stepper_axis_t *minor = axis->minor;
+
+    axis->minor_error += axis->minor_steps;
+    if(axis->minor_error >= axis->major_steps)
     {
-        case CW_STEP_270:   a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CW_STEP_180;     break;
-        case CW_STEP_180:   a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CW_STEP_90;      break;
-        case CW_STEP_90:    a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_FULL; d = DRIVE_ZERO; step = 0;               break;
-        case CW_STEP_0:     a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_FULL; step = CW_STEP_270;     break;
+        axis->minor_error -= axis->major_steps;
+        minor->steps_to_go--;
+        StepAdvance(minor, minor->direction);
+        if(minor->direction) minor->position--;
+        else                 minor->position++;
+    }
+}
 
-        case CCW_STEP_0:    a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_FULL; step = CCW_STEP_90;     break;                  
-        case CCW_STEP_90:   a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_FULL; d = DRIVE_ZERO; step = CCW_STEP_180;    break;
-        case CCW_STEP_180:  a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CCW_STEP_270;    break;
-        case CCW_STEP_270:  a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CCW_STEP_0;      break;
+/* Advances the movement of one motor by one tick */
+static void AxisTick(stepper_axis_t *axis)
+{
+    /* Verifying the speed profile: acceleration, deceleration and constant speed */
+    if(axis->steps_to_go > axis->steps_until_stop)
+    {
+        if(axis->actual_speed < (axis->speed_limit - axis->acceleration))
+        {
+            axis->actual_speed += axis->acceleration;
+        }
+        else if(axis->actual_speed < axis->speed_limit) axis->actual_speed++;
+    }
+    else
+    {
+        if(axis->actual_speed > axis->deceleration)
+        {
+            axis->actual_speed -= axis->deceleration;
+        }
+        else if(axis->actual_speed > 1) axis->actual_speed--;
+    }
+    uint16_t dynamic_amp = (uint16_t)((axis->compensation * (uint32_t)axis->actual_speed) >> 16);
 
-        default:            a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_0;       break; 
-    }   
-#endif /* STEPPING_MODE==FULL_STEP */
+    AmplitudeSet(axis, axis->amplitude + dynamic_amp);
 
-#if STEPPING_MODE == HALF_STEP
-    static step_t step = 0;
-    /*These masks are correlated with step_t */
-    step &= 7;
-    if(direction) step |= 8;
-    
-    switch(step)
+    if(axis->minor != NULL)
     {
-        case CW_STEP_315:  a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_ZERO; d = DRIVE_HALF; step = CW_STEP_270;      break;  
-        case CW_STEP_270:  a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CW_STEP_225;      break;
-        case CW_STEP_225:  a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_HALF; step = CW_STEP_180;      break;
-        case CW_STEP_180:  a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_135;      break;
-        case CW_STEP_135:  a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_HALF; d = DRIVE_ZERO; step = CW_STEP_90;       break;
-        case CW_STEP_90:   a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CW_STEP_45;       break;
-        case CW_STEP_45:   a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_HALF; d = DRIVE_ZERO; step = CW_STEP_0;        break;
-        case CW_STEP_0:    a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_315;      break;  
-        
-        case CCW_STEP_0:   a = DRIVE_ZERO; b = DRIVE_FULL; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CCW_STEP_45;      break;                  
-        case CCW_STEP_45:  a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_HALF; d = DRIVE_ZERO; step = CCW_STEP_90;      break;
-        case CCW_STEP_90:  a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_FULL; d = DRIVE_ZERO; step = CCW_STEP_135;     break;
-        case CCW_STEP_135: a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_HALF; d = DRIVE_ZERO; step = CCW_STEP_180;     break;
-        case CCW_STEP_180: a = DRIVE_FULL; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CCW_STEP_225;     break;                  
-        case CCW_STEP_225: a = DRIVE_HALF; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_HALF; step = CCW_STEP_270;     break;
-        case CCW_STEP_270: a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_FULL; step = CCW_STEP_315;     break;
-        case CCW_STEP_315: a = DRIVE_ZERO; b = DRIVE_HALF; c = DRIVE_ZERO; d = DRIVE_HALF; step = CCW_STEP_0;       break;
-        
-        default:           a = DRIVE_ZERO; b = DRIVE_ZERO; c = DRIVE_ZERO; d = DRIVE_ZERO; step = CW_STEP_0;        break;               
-    }    
-#endif /* STEPPING_MODE==HALF_STEP */
-    
-#if STEPPING_MODE == MICRO_STEP
-    static uint8_t step = 0;
-    uint8_t x = (step & 0x60) | direction;
-       
-    switch(x)
+        stepper_axis_t *minor = axis->minor;
+
+        minor->actual_speed = (uint16_t)(((uint32_t)axis->actual_speed * axis->minor_ratio) >> 15);
+        dynamic_amp = (uint16_t)((minor->compensation * (uint32_t)minor->actual_speed) >> 16);
+        AmplitudeSet(minor, minor->amplitude + dynamic_amp);
+    }
+
+    if(CheckSteps(axis))
     {
-        /* CW */
-        case 0x00:  a = 0;
-                    b = sine_lookup_table[31 - (step & 0x1F)];
-                    c = 0;
-                    d = sine_lookup_table[step & 0x1F];;
-                    break;
-        case 0x20: 
-                    a = sine_lookup_table[step & 0x1F];
-                    b = 0;
-                    c = 0;
-                    d = sine_lookup_table[31 - (step & 0x1F)];
-                    break;
-        case 0x40:            
-                    a = sine_lookup_table[31 - (step & 0x1F)];
-                    b = 0;
-                    c = sine_lookup_table[step & 0x1F];;
-                    d = 0;
-                    break;     
-        case 0x60: 
-                    a = 0;
-                    b = sine_lookup_table[step & 0x1F];
-                    c = sine_lookup_table[31 - (step & 0x1F)];
-                    d = 0;                  
-                    break;
-        
-        /* CCW */
-        case 0x01: 
-                    a = 0;
-                    b = sine_lookup_table[31 - (step & 0x1F)];
-                    c = sine_lookup_table[step & 0x1F];
-                    d = 0;                  
-                    break;
-        case 0x21: 
-                    a = sine_lookup_table[step & 0x1F];
-                    b = 0;
-                    c = sine_lookup_table[31 - (step & 0x1F)];
-                    d = 0;          
-                    break;
-        case 0x41: 
-                    a = sine_lookup_table[31 - (step & 0x1F)];
-                    b = 0;
-                    c = 0;
-                    d = sine_lookup_table[step & 0x1F];            
-                    break;
-        case 0x61:           
-                    a = 0;
-                    b = sine_lookup_table[step & 0x1F];
-                    c = 0;
-                    d = sine_lookup_table[31 - (step & 0x1F)];            
-                    break;
-                    
-        default:   a = 0; b = 0; c = 0; d = 0; break;           
+        axis->steps_to_go--;
+        StepAdvance(axis, axis->direction);
+        if(axis->direction) axis->position--;
+        else                axis->position++;
+
+        if(axis->minor != NULL)
+            MinorStep(axis);
+    }
+
+    if(axis->steps_to_go == 0)
+    {
+        if(axis->minor != NULL)
+        {
+            AxisComplete(axis->minor);
+            axis->minor = NULL;
+        }
+        AxisComplete(axis);
     }
-    step++; step &= 0x7F;
-#endif /* STEPPING_MODE == MICRO_STEP */
-    TCE0_CompareAllChannelsBufferedSet(a, b, c, d);
 }
 
-/* This function is registered as a callback and must be called once in 50 us. */
+/* This function is registered as a callback and must be called once in 50 us. The moving motors are advanced in the same tick. */
 void Stepper_TimeTick(void)
 {
-    time_flag = true;
+    uint8_t k;
+
+    for(k = 0; k < axes_count; k++)
+    {
+        if(axes[k]->busy && (axes[k]->follower == false))
+            AxisTick(axes[k]);
+    }
+#if (DUAL_MODE == SIMULTANEOUS)
+    /* The coil outputs of motor B take the values of this tick once, at the next PWM period */
+    CoilPwm_Update();
+#endif /* DUAL_MODE */
 }
 
 
 void Stepper_Init(void)
 {
-    time_flag = false;
+    axes_count = 0;
     /* Enable hardware scaling accelerator after initialization */
     TCE0_ScaleEnable(true);
     TCE0_AmplitudeSet(DRIVE_ZERO);
     TCE0_CompareAllChannelsBufferedSet(DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO);
+#if (DUAL_MODE == SIMULTANEOUS)
+    CoilPwm_Initialize();
+#else
     USE_TWO_STEPPERS();
+#endif /* DUAL_MODE */
 }
 
-static inline void AmplitudeSet(uint16_t amplitude)
+bool Stepper_AxisAdd(stepper_axis_t *axis)
 {
-    if(amplitude > 32768)
-        amplitude = 32768;
-    TCE0_AmplitudeSet(amplitude);
+    if(axes_count == STEPPER_AXES_MAX)
+        return false;
+
+    axis->busy = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        axes[axes_count++] = axis;
+    }
+    return true;
+}
+
+/* Returns true if the motor or another motor on the same coil outputs is moving */
+static bool OutputsBusy(const stepper_axis_t *axis)
+{
+    uint8_t k;
+
+    for(k = 0; k < axes_count; k++)
+    {
+        if((axes[k]->pwm == axis->pwm) && axes[k]->busy)
+            return true;
+    }
+    return axis->busy;
+}
+
+bool Stepper_IsBusy(const stepper_axis_t *axis)
+{
+    return axis->busy;
+}
+
+stepper_position_t Stepper_GetPosition(const stepper_axis_t *axis)
+{
+    stepper_position_t position;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        position = axis->position;
+    }
+    return position;
+}
+
+void Stepper_PositionSet(stepper_axis_t *axis, stepper_position_t position)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        axis->position = position;
+    }
 }
 
-stepper_position_t Stepper_Move(stepper_position_t initial_position, stepper_position_t steps, uint16_t acceleration, uint16_t deceleration, uint16_t speed_limit, uint16_t vbus_mv)
+/* Computes the profile of a movement, the tick does not touch it until busy is set */
+static void AxisPrepare(stepper_axis_t *axis, stepper_position_t steps, uint16_t acceleration, uint16_t deceleration, uint16_t speed_limit, uint16_t vbus_mv)
 {  
-    stepper_position_t actual_position = initial_position;
-    uint16_t actual_speed = 0;
     bool direction;
     uint32_t steps_to_go;
     uint32_t steps_until_stop = 0;
@@ -266,15 +290,15 @@ stepper_position_t Stepper_Move(stepper_position_t initial_position, stepper_pos
         amplitude    = AMP_TO_U16(0.0);
         compensation = AMP_TO_U16(0.0);
     }
-    else if(vbus_mv <= (uint16_t)V_OUT)
+    else if(vbus_mv <= axis->v_out_mv)
     {
         amplitude    = AMP_TO_U16(1.0);
         compensation = AMP_TO_U16(1.0);
     }
     else
     {
-        amplitude    = AMP_TO_U16(V_OUT  / (float)vbus_mv);
-        compensation = (uint32_t)(K_COMP / (float)vbus_mv);
+        amplitude    = AMP_TO_U16((float)axis->v_out_mv / (float)vbus_mv);
+        compensation = axis->k_comp / vbus_mv;
     }
     
     if(steps < 0)
@@ -302,52 +326,113 @@ stepper_position_t Stepper_Move(stepper_position_t initial_position, stepper_pos
         steps_until_stop = (uint32_t)(acceleration * steps_to_go / (acceleration + deceleration));
     }
 
-    CheckSteps(RESET_CMD, 0);
-        
-    AmplitudeSet(amplitude);
-    
-    /* Now start moving */
-    while(steps_to_go != 0)
+    /* Route the TCE0 outputs to this motor and restore its coil currents, the other motor is left unpowered */
+    if((axis->pwm == &STEPPER_PWM_TCE0) && (PORTMUX.TCEROUTEA != axis->route))
     {
-        /* Verifying the speed profile: acceleration, deceleration and constant speed */
-        if(steps_to_go > steps_until_stop)
-        {
-            if(actual_speed < (speed_limit - acceleration))
-            {
-                actual_speed += acceleration;
-            }
-            else if(actual_speed < speed_limit) actual_speed++;
-        }
-        else
-        {
-            if(actual_speed > deceleration)
-            {
-                actual_speed -= deceleration;
-            }
-            else if(actual_speed > 1) actual_speed--;
-        }
-        uint16_t dynamic_amp = (uint16_t)((compensation * (uint32_t)actual_speed) >> 16);
+        PORTMUX.TCEROUTEA = axis->route;
+#if (RELEASE_IN_IDLE == false)
+        CoilApply(axis);
+#endif /* RELEASE_IN_IDLE */
+    }
 
-        AmplitudeSet(amplitude + dynamic_amp);
-        
-        bool b = CheckSteps(NO_CMD, actual_speed);
-        if(b)
-        {
-            steps_to_go--;
-            StepAdvance(direction);
-            if(direction) actual_position--;
-            else          actual_position++;
-        }
+    AmplitudeSet(axis, amplitude);
+
+    axis->counter          = 0;
+    axis->actual_speed     = 0;
+    axis->steps_to_go      = steps_to_go;
+    axis->steps_until_stop = steps_until_stop;
+    axis->acceleration     = acceleration;
+    axis->deceleration     = deceleration;
+    axis->speed_limit      = speed_limit;
+    axis->amplitude        = amplitude;
+    axis->compensation     = compensation;
+    axis->direction        = direction;
+    axis->minor            = NULL;
+    axis->follower         = false;
+}
+
+bool Stepper_MoveStart(stepper_axis_t *axis, stepper_position_t steps, uint16_t acceleration, uint16_t deceleration, uint16_t speed_limit, uint16_t vbus_mv)
+{
+    if(OutputsBusy(axis))
+        return false;
+
+    if(steps == 0)
+        return true;
+
+    AxisPrepare(axis, steps, acceleration, deceleration, speed_limit, vbus_mv);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        axis->busy = true;
     }
-    /* Movement completed. Now the motor is stopped. */
-    actual_speed = 0;
-    AmplitudeSet(amplitude);
-    
-    /* Release the current through coils */
-#if (RELEASE_IN_IDLE == true)
-    TCE0_CompareAllChannelsBufferedSet(DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO, DRIVE_ZERO);
-#endif /* RELEASE_IN_IDLE */
-    
-    return actual_position;
+    return true;
 }
 
+/* True if x and y can never run a line together: the same motor, or the same coil outputs */
+static bool LineInvalid(const stepper_axis_t *x, const stepper_axis_t *y)
+{
+    return (x == y) || (x->pwm == y->pwm);
+}
+
+bool Stepper_MoveXYStart(stepper_axis_t *x, stepper_axis_t *y, stepper_position_t dx, stepper_position_t dy, uint16_t acceleration, uint16_t deceleration, uint16_t speed_limit, uint16_t vbus_mv)
+{
+    stepper_axis_t *major = x;
+    stepper_axis_t *minor = y;
+    stepper_position_t d_major = dx;
+    stepper_position_t d_minor = dy;
+
+    if(LineInvalid(x, y) || OutputsBusy(x) || OutputsBusy(y))
+        return false;
+
+    if((dx == 0) && (dy == 0))
+        return true;
+
+    if(((dy < 0) ? (uint32_t)(0 - dy) : (uint32_t)dy) > ((dx < 0) ? (uint32_t)(0 - dx) : (uint32_t)dx))
+    {
+        major = y;
+        minor = x;
+        d_major = dy;
+        d_minor = dx;
+    }
+
+    /* The minor axis only takes the direction, amplitude and length from its profile */
+    AxisPrepare(major, d_major, acceleration, deceleration, speed_limit, vbus_mv);
+    AxisPrepare(minor, d_minor, acceleration, deceleration, speed_limit, vbus_mv);
+
+    major->major_steps = major->steps_to_go;
+    major->minor_steps = minor->steps_to_go;
+    /* Starting from the middle rounds the minor position to the nearest sub-step of the line */
+    major->minor_error = major->steps_to_go >> 1;
+    major->minor_ratio = (uint16_t)(((uint64_t)minor->steps_to_go << 15) / major->steps_to_go);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        minor->follower = true;
+        major->minor    = minor;
+        minor->busy     = true;
+        major->busy     = true;
+    }
+    return true;
+}
+
+stepper_position_t Stepper_Move(stepper_axis_t *axis, stepper_position_t steps, uint16_t acceleration, uint16_t deceleration, uint16_t speed_limit, uint16_t vbus_mv)
+{
+    while(Stepper_MoveStart(axis, steps, acceleration, deceleration, speed_limit, vbus_mv) == false);
+
+    while(Stepper_IsBusy(axis));
+
+    return Stepper_GetPosition(axis);
+}
+
+bool Stepper_MoveXY(stepper_axis_t *x, stepper_axis_t *y, stepper_position_t dx, stepper_position_t dy, uint16_t acceleration, uint16_t deceleration, uint16_t speed_limit, uint16_t vbus_mv)
+{
+    /* Waiting only makes sense while the motors are busy */
+    if(LineInvalid(x, y))
+        return false;
+
+    while(Stepper_MoveXYStart(x, y, dx, dy, acceleration, deceleration, speed_limit, vbus_mv) == false);
+
+    while(Stepper_IsBusy(x) || Stepper_IsBusy(y));
+
+    return true;
+}
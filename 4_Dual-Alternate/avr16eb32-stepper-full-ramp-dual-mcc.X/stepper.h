@@ -2,6 +2,8 @@
 #define STEPPER_H
 
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <avr/io.h>
 
@@ -9,19 +11,15 @@
 /* Total number of steps a motor spins in a duration */
 typedef int32_t  stepper_position_t;
 
-/* Sets TCE output on PORTA */
-#define USE_STEPPER_A()                         ({PORTMUX.TCEROUTEA = PORTMUX_TCE0_PORTA_gc;})
+/* TCE output on PORTA */
+#define STEPPER_ROUTE_A                         PORTMUX_TCE0_PORTA_gc
 
-/* Sets TCE output on PORTD */
-#define USE_STEPPER_B()                         ({PORTMUX.TCEROUTEA = PORTMUX_TCE0_PORTD_gc;})
+/* TCE output on PORTD */
+#define STEPPER_ROUTE_B                         PORTMUX_TCE0_PORTD_gc
 
 /* Sets PORTD as output*/
 #define USE_TWO_STEPPERS()                      ({PORTD.DIR = 0xFF;}) 
 
-/* Sets ADC inputs */
-#define VBUS_ADC_A                              ADC_MUXPOS_AIN20_gc
-#define VBUS_ADC_B                              ADC_MUXPOS_AIN28_gc
-
 /* USER DEFINE CONFIGS*/
 /* MOTOR SPECIFIC*/
 #define R                  2.6                  /* Motor Windings Resistance  [ohm] */
@@ -29,6 +27,9 @@ typedef int32_t  stepper_position_t;
 #define STEP_SIZE          1.8                  /* Motor degrees / full-step */
 #define KV                 5.6                  /* Proportionality constant for BEMF compensation 1.0 ... 10.0 */
 #define RELEASE_IN_IDLE    true                 /* True: for power savings, the current through the coils is stopped. */
+#ifndef DUAL_MODE                               /* Can be set on the compiler command line, as the host tests do */
+#define DUAL_MODE          ALTERNATE            /* ALTERNATE or SIMULTANEOUS, see the definitions below */
+#endif
 
 
 /* Select the desired stepping mode(only one of them) */
@@ -52,6 +53,22 @@ typedef int32_t  stepper_position_t;
 #define DRIVE_ZERO                              AMP_TO_U16(0.0)
 
 
+/* Definitions for the dual drive modes */
+#define ALTERNATE       1                       /* Both motors on TCE0/WEX0, routed by PORTMUX. One motor moves at a time. */
+#define SIMULTANEOUS    2                       /* Motor A on TCE0/WEX0, motor B on the TCF0 and TCB0/TCB1 PWM outputs. Both motors move at the same time. */
+
+
+/* Sets ADC inputs */
+#if (DUAL_MODE == SIMULTANEOUS)
+/* PF4 and PC0 carry the coil PWM of motor B, see coil_pwm.h, so VBUS is read on PF2 and PF3 */
+#define VBUS_ADC_A                              ADC_MUXPOS_AIN18_gc
+#define VBUS_ADC_B                              ADC_MUXPOS_AIN19_gc
+#else
+#define VBUS_ADC_A                              ADC_MUXPOS_AIN20_gc
+#define VBUS_ADC_B                              ADC_MUXPOS_AIN28_gc
+#endif /* DUAL_MODE */
+
+
 /* Definitions for stepper drive modes */
 #define HALF_STEP   1
 #define FULL_STEP   2
@@ -93,17 +110,103 @@ typedef int32_t  stepper_position_t;
 #define SUBSTEPS_TO_STEPS(SUBST)                ((float)(SUBST)/(float)K_MODE)
 
 
+/* Coil PWM outputs of a power board: the four duty cycles in U.Q.1.15 format, scaled by the amplitude */
+typedef struct
+{
+    void (*AmplitudeSet)(uint16_t);
+    void (*CompareAllChannelsBufferedSet)(uint16_t, uint16_t, uint16_t, uint16_t);
+} stepper_pwm_t;
+
+/* TCE0/WEX0 outputs, routed to the power board of the moving motor */
+extern const stepper_pwm_t STEPPER_PWM_TCE0;
+
+#if (DUAL_MODE == SIMULTANEOUS)
+/* TCF0 and TCB0/TCB1 outputs, see coil_pwm.h */
+extern const stepper_pwm_t STEPPER_PWM_COIL;
+#define STEPPER_PWM_B                           (&STEPPER_PWM_COIL)
+#else
+#define STEPPER_PWM_B                           (&STEPPER_PWM_TCE0)
+#endif /* DUAL_MODE */
+
+/* Number of motors Stepper_TimeTick can drive */
+#define STEPPER_AXES_MAX                        2
+
+
+/* Per-motor context. Everything that belongs to one motor is kept here, so every motor keeps its own
+ * electrical angle, position and movement, and switching to another motor is only passing another pointer.
+ * The movement fields are written by Stepper_MoveStart while the motor is idle and then only by Stepper_TimeTick. */
+typedef struct stepper_axis
+{
+    stepper_position_t position;
+    uint16_t           step;                    /* Electrical index, 4 * K_MODE per electrical period */
+    uint16_t           counter;                 /* Step phase accumulator, a sub-step is made when it overflows */
+    /* Movement */
+    uint32_t           steps_to_go;
+    uint32_t           steps_until_stop;        /* Deceleration starts when steps_to_go reaches it */
+    uint16_t           actual_speed;
+    uint16_t           acceleration;
+    uint16_t           deceleration;
+    uint16_t           speed_limit;
+    uint16_t           amplitude;               /* Drive amplitude at standstill */
+    uint32_t           compensation;            /* BEMF amplitude increase per speed unit */
+    bool               direction;
+    volatile bool      busy;
+    /* Linear interpolation, see Stepper_MoveXYStart */
+    struct stepper_axis *minor;                 /* Axis stepped by this one, NULL if none */
+    uint32_t           major_steps;             /* Length of the line on this axis */
+    uint32_t           minor_steps;             /* Length of the line on the minor axis */
+    uint32_t           minor_error;             /* Bresenham error, a minor sub-step is made when it reaches major_steps */
+    uint16_t           minor_ratio;             /* Minor / major speed in U.Q.1.15 format, for the BEMF compensation */
+    bool               follower;                /* Stepped by its major axis instead of its own profile */
+    /* Motor and power board */
+    uint16_t           v_out_mv;                /* Motor output voltage: winding resistance * current limit [mV] */
+    uint32_t           k_comp;                  /* BEMF compensation constant */
+    const stepper_pwm_t *pwm;                   /* Coil PWM outputs */
+    uint8_t            route;                   /* PORTMUX TCE0 route of the power board, used with STEPPER_PWM_TCE0 */
+    ADC_MUXPOS_t       vbus_channel;            /* ADC input of the power board supply voltage */
+} stepper_axis_t;
+
+/* Static initializer of a stepper_axis_t
+    route: STEPPER_ROUTE_A or STEPPER_ROUTE_B
+    pwm: &STEPPER_PWM_TCE0 or STEPPER_PWM_B
+    vbus_channel: ADC input of the supply voltage
+    r, i_out, kv: motor windings resistance [ohm], output current limit [mA] and BEMF constant, as R, I_OUT and KV
+*/
+#define STEPPER_AXIS(ROUTE, PWM, VBUS_CHANNEL, R_OHM, I_OUT_MA, K_V) \
+    { .position = 0, .step = 0, .counter = 0, .busy = false,  \
+      .minor = NULL, .follower = false,                       \
+      .v_out_mv = (uint16_t)((R_OHM) * (I_OUT_MA) + 0.5),     \
+      .k_comp = (uint32_t)(1000000000.0 * (float)(K_V) / (float)K_MODE), \
+      .pwm = (PWM), .route = (ROUTE), .vbus_channel = (VBUS_CHANNEL) }
+
+
 /* Function Prototypes*/
 /* params:
+    axis: motor to move. With STEPPER_PWM_TCE0 the TCE0 outputs are routed to its power board for the movement.
     steps: if negative, then go CCW, if positive - go CW
     acceleration, deceleration: steps / s^2
     speed: steps/s
     vbus: vbus expressed in mV
 
-  returns: new position of the stepper motor
+  Stepper_MoveStart returns false, without starting, while the motor or another motor on the same outputs is moving.
+  The movement is run by Stepper_TimeTick. Stepper_Move waits for the outputs, moves and returns the new position.
+*/
+bool               Stepper_MoveStart(stepper_axis_t *, stepper_position_t, uint16_t, uint16_t, uint16_t, uint16_t);
+stepper_position_t Stepper_Move(stepper_axis_t *, stepper_position_t, uint16_t, uint16_t, uint16_t, uint16_t);
+/* Straight line: x and y start and stop in the same tick. The axis with the longer displacement is the major axis,
+   it runs the profile with the given acceleration, deceleration and speed, and the other axis follows it with a
+   Bresenham error accumulator, staying within half a sub-step of the line. x and y must use different coil outputs.
+   Stepper_MoveXYStart returns false, without starting, while one of the motors or their outputs is busy, and when
+   x and y are the same motor or share their outputs. Stepper_MoveXY waits for the motors, runs the line and returns
+   true, or returns false at once if x and y can never run together, as with the ALTERNATE mode.
 */
-stepper_position_t Stepper_Move(stepper_position_t, stepper_position_t, uint16_t, uint16_t, uint16_t, uint16_t);
-void               Stepper_TimeTick(void);  /* Called periodically from interrupt context */
+bool               Stepper_MoveXYStart(stepper_axis_t *, stepper_axis_t *, stepper_position_t, stepper_position_t, uint16_t, uint16_t, uint16_t, uint16_t);
+bool               Stepper_MoveXY(stepper_axis_t *, stepper_axis_t *, stepper_position_t, stepper_position_t, uint16_t, uint16_t, uint16_t, uint16_t);
+bool               Stepper_IsBusy(const stepper_axis_t *);
+void               Stepper_TimeTick(void);  /* Called periodically from interrupt context, advances all the added motors */
 void               Stepper_Init(void);
+bool               Stepper_AxisAdd(stepper_axis_t *);  /* Adds a motor to Stepper_TimeTick. False if STEPPER_AXES_MAX are added. */
+stepper_position_t Stepper_GetPosition(const stepper_axis_t *);
+void               Stepper_PositionSet(stepper_axis_t *, stepper_position_t);
 
 #endif /*  STEPPER_H  */
\ No newline at end of file
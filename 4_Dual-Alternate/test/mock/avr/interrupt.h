@@ -0,0 +1,10 @@
+#ifndef MOCK_AVR_INTERRUPT_H
+#define MOCK_AVR_INTERRUPT_H
+
+
+#include <avr/io.h>
+
+#define sei()
+#define cli()
+
+#endif /* MOCK_AVR_INTERRUPT_H */
@@ -0,0 +1,82 @@
+#ifndef MOCK_AVR_IO_H
+#define MOCK_AVR_IO_H
+
+
+#include <stdint.h>
+
+
+/* Host replacement of <avr/io.h>: only the registers and bit names used by the stepper sources.
+ * The register blocks are plain variables defined in mock.c, the tests write their inputs and read their outputs. */
+
+#define ISR(vector)                             void vector(void)
+
+#define PIN0_bm                                 0x01
+#define PIN1_bm                                 0x02
+#define PIN2_bm                                 0x04
+#define PIN3_bm                                 0x08
+#define PIN4_bm                                 0x10
+#define PIN5_bm                                 0x20
+#define PIN6_bm                                 0x40
+#define PIN7_bm                                 0x80
+
+typedef struct
+{
+    volatile uint8_t DIR, DIRSET, DIRCLR, DIRTGL;
+    volatile uint8_t OUT, OUTSET, OUTCLR, OUTTGL;
+    volatile uint8_t IN, INTFLAGS;
+} PORT_t;
+
+typedef struct
+{
+    volatile uint8_t EVSYSROUTEA, CCLROUTEA, USARTROUTEA, SPIROUTEA, TWIROUTEA, TCEROUTEA, TCBROUTEA, TCFROUTEA;
+} PORTMUX_t;
+
+#define PORTMUX_TCE0_PORTA_gc                   0x00
+#define PORTMUX_TCE0_PORTD_gc                   0x03
+
+#define PORTMUX_TCF0_ALT2_gc                    0x02
+#define PORTMUX_TCB0_ALT1_gc                    0x01
+#define PORTMUX_TCB1_ALT1_gc                    0x02
+
+/* Coil PWM timers of the SIMULTANEOUS mode: a test sets TCB0.CNT to place the TCB0 interrupt in the PWM period */
+typedef struct
+{
+    volatile uint8_t  CTRLA, CTRLB, EVCTRL, INTCTRL, INTFLAGS, STATUS;
+    volatile uint16_t CNT, CCMP;
+} TCB_t;
+
+#define TCB_ENABLE_bm                           0x01
+#define TCB_CLKSEL_DIV2_gc                      0x02
+#define TCB_CNTMODE_PWM8_gc                     0x07
+#define TCB_CCMPEN_bm                           0x10
+#define TCB_CAPT_bm                             0x01
+
+typedef struct
+{
+    volatile uint8_t  CTRLA, CTRLB, CTRLC, CTRLD, EVCTRL, INTCTRL, INTFLAGS, STATUS;
+    volatile uint16_t CNT, CMP0, CMP1;
+} TCF_t;
+
+#define TCF_ENABLE_bm                           0x01
+#define TCF_PRESC_DIV2_gc                       0x02
+#define TCF_CLKSEL_CLKPER_gc                    0x00
+#define TCF_WGMODE_PWM8_gc                      0x05
+#define TCF_WO0EN_bm                            0x01
+#define TCF_WO1EN_bm                            0x02
+
+/* Types of the TCE0 driver prototypes, the driver itself is replaced by mock.c */
+typedef uint8_t TCE_WGMODE_t, TCE_CMD_t, TCE_CLKSEL_t, TCE_HREN_t, TCE_SCALEMODE_t;
+
+typedef uint8_t ADC_MUXPOS_t;
+
+#define ADC_MUXPOS_AIN18_gc                     0x12
+#define ADC_MUXPOS_AIN19_gc                     0x13
+#define ADC_MUXPOS_AIN20_gc                     0x14
+#define ADC_MUXPOS_AIN28_gc                     0x1C
+
+extern PORT_t    PORTA, PORTC, PORTD, PORTF;
+extern PORTMUX_t PORTMUX;
+extern TCB_t     TCB0, TCB1;
+extern TCF_t     TCF0;
+
+#endif /* MOCK_AVR_IO_H */
@@ -0,0 +1,89 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "mcc_generated_files/timer/tce0.h"
+#include "mock.h"
+
+
+PORT_t    PORTA, PORTC, PORTD, PORTF;
+PORTMUX_t PORTMUX;
+TCB_t     TCB0, TCB1;
+TCF_t     TCF0;
+
+volatile uint16_t mock_compare[4];
+volatile uint16_t mock_amplitude;
+volatile uint32_t mock_ticks;
+int               mock_failures;
+
+static pthread_mutex_t interrupts = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static pthread_t       ticker;
+static void          (*ticker_tick)(void);
+static volatile bool   ticker_run;
+
+int Mock_InterruptsDisable(void)
+{
+    pthread_mutex_lock(&interrupts);
+    return 1;
+}
+
+void Mock_InterruptsRestore(int *state)
+{
+    (void)state;
+    pthread_mutex_unlock(&interrupts);
+}
+
+static void *TickerThread(void *argument)
+{
+    (void)argument;
+    while(ticker_run)
+    {
+        pthread_mutex_lock(&interrupts);
+        ticker_tick();
+        mock_ticks++;
+        pthread_mutex_unlock(&interrupts);
+        sched_yield();
+    }
+    return NULL;
+}
+
+void Mock_TickerStart(void (*tick)(void))
+{
+    ticker_tick = tick;
+    ticker_run = true;
+    pthread_create(&ticker, NULL, TickerThread, NULL);
+}
+
+void Mock_TickerStop(void)
+{
+    ticker_run = false;
+    pthread_join(ticker, NULL);
+}
+
+int Mock_Result(const char *name)
+{
+    printf("%s: %s\n", name, (mock_failures == 0) ? "PASS" : "FAIL");
+    return (mock_failures == 0) ? 0 : 1;
+}
+
+void TCE0_CompareAllChannelsBufferedSet(uint16_t value0, uint16_t value1, uint16_t value2, uint16_t value3)
+{
+    mock_compare[0] = value0;
+    mock_compare[1] = value1;
+    mock_compare[2] = value2;
+    mock_compare[3] = value3;
+}
+
+void TCE0_AmplitudeSet(uint16_t value)
+{
+    mock_amplitude = value;
+}
+
+void TCE0_ScaleEnable(bool state)
+{
+    (void)state;
+}
@@ -0,0 +1,19 @@
+#ifndef MOCK_UTIL_ATOMIC_H
+#define MOCK_UTIL_ATOMIC_H
+
+
+/* Host replacement of <util/atomic.h>. The interrupts are a recursive lock, held by Mock_TickerStart's thread around
+ * every tick, so an ATOMIC_BLOCK excludes the tick as on the device. As in avr-libc, the lock is released when the
+ * block is left in any way. */
+
+int  Mock_InterruptsDisable(void);
+void Mock_InterruptsRestore(int *state);
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+#define ATOMIC_BLOCK(type)                                                                                  \
+    for(int mock_state __attribute__((__cleanup__(Mock_InterruptsRestore))) = Mock_InterruptsDisable(),    \
+        mock_once = 1; mock_once; mock_once = 0)
+
+#endif /* MOCK_UTIL_ATOMIC_H */
@@ -0,0 +1,135 @@
+/* Straight line (user-015): the step stream of both motors, followed through their coil outputs, stays within half
+ * a sub-step of the line, the motors start and stop in the same tick, and Stepper_MoveXY refuses at once two axes
+ * that can never run together instead of waiting for them. */
+#include <math.h>
+#include "stepper.c"
+#include "mock.h"
+
+
+#define ACCELERATION    DEGPS_TO_U16(0.3)
+#define SPEED           SPEED_LIMIT(DEGPS_TO_U16(360))
+#define VBUS            12000
+#define TICKS_MAX       1000000UL
+
+/* Coil outputs of each motor: the writes of a tick are counted, the electrical index is read back from the axis */
+static uint32_t writes_x;
+static uint32_t writes_y;
+
+static void AmplitudeX(uint16_t value) { (void)value; }
+static void AmplitudeY(uint16_t value) { (void)value; }
+
+static void CompareX(uint16_t a, uint16_t b, uint16_t c, uint16_t d)
+{
+    (void)a; (void)b; (void)c; (void)d;
+    writes_x++;
+}
+
+static void CompareY(uint16_t a, uint16_t b, uint16_t c, uint16_t d)
+{
+    (void)a; (void)b; (void)c; (void)d;
+    writes_y++;
+}
+
+static const stepper_pwm_t pwm_x = { AmplitudeX, CompareX };
+static const stepper_pwm_t pwm_y = { AmplitudeY, CompareY };
+
+static stepper_axis_t x = STEPPER_AXIS(STEPPER_ROUTE_A, &pwm_x, VBUS_ADC_A, R, I_OUT, KV);
+static stepper_axis_t y = STEPPER_AXIS(STEPPER_ROUTE_B, &pwm_y, VBUS_ADC_B, R, I_OUT, KV);
+
+/* Runs a line to its end tick by tick and checks the step stream */
+static void Line(stepper_position_t dx, stepper_position_t dy)
+{
+    stepper_position_t x0 = x.position;
+    stepper_position_t y0 = y.position;
+    double             error_max = 0.0;
+    uint32_t           ticks;
+    uint32_t           first_x = 0;
+    uint32_t           first_y = 0;
+    uint32_t           end_x = 0;
+    uint32_t           end_y = 0;
+    double             length = (labs(dx) > labs(dy)) ? (double)labs(dx) : (double)labs(dy);
+
+    CHECK(Stepper_MoveXYStart(&x, &y, dx, dy, ACCELERATION, ACCELERATION, SPEED, VBUS), "line %ld, %ld refused", (long)dx, (long)dy);
+    for(ticks = 1; (x.busy || y.busy) && (ticks < TICKS_MAX); ticks++)
+    {
+        stepper_position_t px = x.position;
+        stepper_position_t py = y.position;
+        uint16_t           sx = x.step;
+        uint16_t           sy = y.step;
+        double             distance;
+
+        writes_x = 0;
+        writes_y = 0;
+        Stepper_TimeTick();
+
+        /* One sub-step per tick at most, and the coil outputs written with every sub-step */
+        CHECK(labs(x.position - px) <= 1 && labs(y.position - py) <= 1, "line %ld, %ld: several sub-steps in a tick", (long)dx, (long)dy);
+        CHECK((x.step != sx) == (x.position != px) && (y.step != sy) == (y.position != py), "line %ld, %ld: angle and position apart", (long)dx, (long)dy);
+        if(x.position != px)
+            CHECK(writes_x != 0, "line %ld, %ld: x sub-step without output", (long)dx, (long)dy);
+        if(y.position != py)
+            CHECK(writes_y != 0, "line %ld, %ld: y sub-step without output", (long)dx, (long)dy);
+        if((first_x == 0) && (x.position != x0))
+            first_x = ticks;
+        if((first_y == 0) && (y.position != y0))
+            first_y = ticks;
+        if(x.busy == false && end_x == 0)
+            end_x = ticks;
+        if(y.busy == false && end_y == 0)
+            end_y = ticks;
+
+        /* Distance from the line along the minor axis, in sub-steps */
+        if(labs(dx) >= labs(dy))
+            distance = (double)(y.position - y0) - (double)(x.position - x0) * (double)dy / (double)dx;
+        else
+            distance = (double)(x.position - x0) - (double)(y.position - y0) * (double)dx / (double)dy;
+        if(fabs(distance) > error_max)
+            error_max = fabs(distance);
+    }
+    printf("line %6ld, %6ld: %lu ticks, path error %.3f sub-steps\n", (long)dx, (long)dy, (unsigned long)ticks, error_max);
+    CHECK(x.position == x0 + dx && y.position == y0 + dy, "line %ld, %ld: end at %ld, %ld", (long)dx, (long)dy,
+          (long)(x.position - x0), (long)(y.position - y0));
+    CHECK(error_max <= 0.5 + 1e-9 * length, "line %ld, %ld: %.3f sub-steps from the line", (long)dx, (long)dy, error_max);
+    CHECK(end_x == end_y, "line %ld, %ld: x stops in tick %lu, y in %lu", (long)dx, (long)dy, (unsigned long)end_x, (unsigned long)end_y);
+    if((dx != 0) && (dy != 0) && (labs(dx) == labs(dy)))
+        CHECK(first_x == first_y, "line %ld, %ld: x starts in tick %lu, y in %lu", (long)dx, (long)dy, (unsigned long)first_x, (unsigned long)first_y);
+    CHECK(x.minor == NULL && y.minor == NULL && x.follower == false && y.follower == false, "line %ld, %ld: link left", (long)dx, (long)dy);
+}
+
+int main(void)
+{
+    static const stepper_position_t lines[][2] =
+    {
+        { 12800, 6400 }, { -6400, 12800 }, { 12800, -1 }, { 3, -12800 }, { -4000, -4000 },
+        { 9999, 7777 }, { 0, 3200 }, { 3200, 0 }, { 1, 1 }, { -12345, 54321 },
+    };
+    stepper_axis_t same_output = STEPPER_AXIS(STEPPER_ROUTE_B, &pwm_x, VBUS_ADC_B, R, I_OUT, KV);
+    uint8_t        k;
+
+    Stepper_Init();
+    CHECK(Stepper_AxisAdd(&x) && Stepper_AxisAdd(&y), "axes not added");
+
+    for(k = 0; k < sizeof(lines) / sizeof(lines[0]); k++)
+        Line(lines[k][0], lines[k][1]);
+
+    /* Never possible: refused at once, also by the blocking call, which used to wait forever */
+    CHECK(Stepper_MoveXYStart(&x, &x, 100, 100, ACCELERATION, ACCELERATION, SPEED, VBUS) == false, "same motor accepted");
+    CHECK(Stepper_MoveXY(&x, &x, 100, 100, ACCELERATION, ACCELERATION, SPEED, VBUS) == false, "same motor accepted");
+    CHECK(Stepper_MoveXY(&x, &same_output, 100, 100, ACCELERATION, ACCELERATION, SPEED, VBUS) == false, "same outputs accepted");
+    CHECK(x.busy == false && same_output.busy == false, "refused line started");
+
+    /* Busy: Stepper_MoveXY waits for the movement in progress, then runs the line */
+    {
+        stepper_position_t x0 = x.position;
+        stepper_position_t y0 = y.position;
+
+        Mock_TickerStart(Stepper_TimeTick);
+        CHECK(Stepper_MoveStart(&x, 3200, ACCELERATION, ACCELERATION, SPEED, VBUS), "movement refused");
+        CHECK(Stepper_MoveXYStart(&x, &y, 100, 100, ACCELERATION, ACCELERATION, SPEED, VBUS) == false, "line started on a busy motor");
+        CHECK(Stepper_MoveXY(&x, &y, -6400, 3200, ACCELERATION, ACCELERATION, SPEED, VBUS), "line refused");
+        Mock_TickerStop();
+        CHECK(x.position == x0 + 3200 - 6400 && y.position == y0 + 3200, "after waiting: %ld, %ld", (long)(x.position - x0), (long)(y.position - y0));
+    }
+
+    return Mock_Result("test_line");
+}
@@ -0,0 +1,212 @@
+/* SIMULTANEOUS mode (user-014): motor A on the TCE0 outputs and motor B on the coil PWM timers move in the same ticks
+ * exactly as each of them alone. The coil duty cycles are computed once per tick and written only by the TCB0 interrupt
+ * at the start of a PWM period, within two timer clocks of the exact product, and a late interrupt waits for the next
+ * period instead of writing a duty cycle below the counter. */
+#include <math.h>
+#include "stepper.c"
+#include "coil_pwm.c"
+#include "mock.h"
+
+
+#define ACCELERATION    DEGPS_TO_U16(0.3)
+#define SPEED           SPEED_LIMIT(DEGPS_TO_U16(360))
+#define VBUS            12000
+#define DISPLACEMENT_A  3200
+#define DISPLACEMENT_B  (-1600)
+#define TICKS_MAX       200000UL
+
+/* Outputs of a motor after a tick */
+typedef struct
+{
+    stepper_position_t position;
+    uint16_t           amplitude;
+    uint16_t           channel[4];
+} record_t;
+
+static record_t record_a[TICKS_MAX];
+static record_t record_b[TICKS_MAX];
+static uint32_t ticks_a;
+static uint32_t ticks_b;
+
+static stepper_axis_t a;
+static stepper_axis_t b;
+
+static void Reset(void)
+{
+    stepper_axis_t axis_a = STEPPER_AXIS(STEPPER_ROUTE_A, &STEPPER_PWM_TCE0, VBUS_ADC_A, R, I_OUT, KV);
+    stepper_axis_t axis_b = STEPPER_AXIS(STEPPER_ROUTE_B, STEPPER_PWM_B, VBUS_ADC_B, R, I_OUT, KV);
+
+    a = axis_a;
+    b = axis_b;
+    Stepper_Init();
+    CHECK(Stepper_AxisAdd(&a) && Stepper_AxisAdd(&b), "axes not added");
+}
+
+static void RecordA(record_t *record)
+{
+    record->position = a.position;
+    record->amplitude = mock_amplitude;
+    record->channel[0] = mock_compare[0];
+    record->channel[1] = mock_compare[1];
+    record->channel[2] = mock_compare[2];
+    record->channel[3] = mock_compare[3];
+}
+
+static void RecordB(record_t *record)
+{
+    record->position = b.position;
+    record->amplitude = coil_amplitude;
+    record->channel[0] = coil_channel[0];
+    record->channel[1] = coil_channel[1];
+    record->channel[2] = coil_channel[2];
+    record->channel[3] = coil_channel[3];
+}
+
+static bool Same(const record_t *x, const record_t *y)
+{
+    return (x->position == y->position) && (x->amplitude == y->amplitude) && (x->channel[0] == y->channel[0])
+           && (x->channel[1] == y->channel[1]) && (x->channel[2] == y->channel[2]) && (x->channel[3] == y->channel[3]);
+}
+
+/* Runs one motor alone and records its outputs */
+static uint32_t Alone(stepper_axis_t *axis, stepper_position_t displacement, record_t *record, void (*Record)(record_t *))
+{
+    uint32_t ticks;
+
+    Reset();
+    CHECK(Stepper_MoveStart(axis, displacement, ACCELERATION, ACCELERATION, SPEED, VBUS), "movement refused");
+    for(ticks = 0; axis->busy && (ticks < TICKS_MAX); ticks++)
+    {
+        Stepper_TimeTick();
+        Record(&record[ticks]);
+    }
+    CHECK(axis->position == displacement, "alone: end at %ld", (long)axis->position);
+    return ticks;
+}
+
+static uint16_t Registers(uint8_t k)
+{
+    switch(k)
+    {
+        case 0:  return TCF0.CMP0;
+        case 1:  return TCF0.CMP1;
+        case 2:  return TCB0.CCMP;
+        default: return TCB1.CCMP;
+    }
+}
+
+/* Duty cycle of a channel in timer clocks, from the register value */
+static uint8_t Duty(uint16_t value)
+{
+    CHECK((value & 0xFF) == COIL_PWM_PERIOD - 1, "period %u in the register", value & 0xFF);
+    return (uint8_t)(value >> 8);
+}
+
+/* Both motors together: the same outputs as alone in every tick, the coil registers written only at a period start */
+static void Together(void)
+{
+    uint32_t ticks;
+    uint32_t deferred = 0;
+    uint32_t writes = 0;
+    double   error_max = 0.0;
+
+    Reset();
+    CHECK(Stepper_MoveStart(&a, DISPLACEMENT_A, ACCELERATION, ACCELERATION, SPEED, VBUS)
+          && Stepper_MoveStart(&b, DISPLACEMENT_B, ACCELERATION, ACCELERATION, SPEED, VBUS), "movements refused");
+    for(ticks = 0; (a.busy || b.busy) && (ticks < TICKS_MAX); ticks++)
+    {
+        uint16_t before[4];
+        record_t now;
+        uint8_t  k;
+
+        for(k = 0; k < 4; k++)
+            before[k] = Registers(k);
+        Stepper_TimeTick();
+
+        RecordA(&now);
+        if(ticks < ticks_a)
+            CHECK(Same(&now, &record_a[ticks]), "motor A apart from its movement alone in tick %lu", (unsigned long)ticks);
+        RecordB(&now);
+        if(ticks < ticks_b)
+            CHECK(Same(&now, &record_b[ticks]), "motor B apart from its movement alone in tick %lu", (unsigned long)ticks);
+
+        /* The tick itself leaves the registers as they are */
+        for(k = 0; k < 4; k++)
+            CHECK(Registers(k) == before[k], "register %u written in the tick %lu", k, (unsigned long)ticks);
+        if((TCB0.INTCTRL & TCB_CAPT_bm) == 0)
+            continue;
+
+        /* One tick in seven the interrupt comes too late in the period: nothing is written until the next one */
+        if((ticks % 7) == 3)
+        {
+            TCB0.CNT = COIL_PWM_GUARD + 1 + (ticks % 100);
+            TCB0_INT_vect();
+            for(k = 0; k < 4; k++)
+                CHECK(Registers(k) == before[k], "register %u written late in the period, tick %lu", k, (unsigned long)ticks);
+            CHECK(TCB0.INTCTRL & TCB_CAPT_bm, "late write dropped in tick %lu", (unsigned long)ticks);
+            deferred++;
+        }
+        TCB0.CNT = ticks % (COIL_PWM_GUARD + 1);
+        TCB0_INT_vect();
+        CHECK((TCB0.INTCTRL & TCB_CAPT_bm) == 0, "interrupt left enabled in tick %lu", (unsigned long)ticks);
+        writes++;
+
+        for(k = 0; k < 4; k++)
+        {
+            double exact = (double)coil_channel[k] / 32768.0 * (double)coil_amplitude / 32768.0 * COIL_PWM_PERIOD;
+            double error = fabs((double)Duty(Registers(k)) - exact);
+
+            if(error > error_max)
+                error_max = error;
+        }
+    }
+    printf("together: %lu ticks, %lu period writes, %lu deferred, duty cycle error %.3f timer clocks\n", (unsigned long)ticks,
+           (unsigned long)writes, (unsigned long)deferred, error_max);
+    CHECK(a.position == DISPLACEMENT_A && b.position == DISPLACEMENT_B, "end at %ld, %ld", (long)a.position, (long)b.position);
+    CHECK(ticks == ((ticks_a > ticks_b) ? ticks_a : ticks_b), "%lu ticks, alone %lu and %lu", (unsigned long)ticks,
+          (unsigned long)ticks_a, (unsigned long)ticks_b);
+    CHECK(error_max <= 2.0, "duty cycle %.3f timer clocks from the exact one", error_max);
+    CHECK(writes != 0 && deferred != 0, "no period write");
+}
+
+/* Every amplitude and channel value against the exact product */
+static void Scaling(void)
+{
+    double   error_max = 0.0;
+    uint32_t amplitude;
+    uint32_t channel;
+
+    for(amplitude = 0; amplitude <= 32768; amplitude += 32)
+    {
+        for(channel = 0; channel <= 32768; channel += 5)
+        {
+            double exact = (double)channel / 32768.0 * (double)amplitude / 32768.0 * COIL_PWM_PERIOD;
+            double error;
+
+            CoilPwm_AmplitudeSet((uint16_t)amplitude);
+            CoilPwm_CompareAllChannelsBufferedSet((uint16_t)channel, 0, 0, 0);
+            CoilPwm_Update();
+            error = fabs((double)Duty(coil_duty[0]) - exact);
+            if(error > error_max)
+                error_max = error;
+        }
+    }
+    printf("scaling: duty cycle error %.3f timer clocks at most\n", error_max);
+    CHECK(error_max <= 2.0, "scaling: %.3f timer clocks from the exact duty cycle", error_max);
+
+    /* Nothing changed: no new write requested */
+    TCB0.INTCTRL = 0;
+    CoilPwm_Update();
+    CHECK(TCB0.INTCTRL == 0, "write requested without a change");
+}
+
+int main(void)
+{
+    ticks_a = Alone(&a, DISPLACEMENT_A, record_a, RecordA);
+    ticks_b = Alone(&b, DISPLACEMENT_B, record_b, RecordB);
+    printf("alone: motor A %lu ticks, motor B %lu ticks\n", (unsigned long)ticks_a, (unsigned long)ticks_b);
+    Together();
+    Scaling();
+
+    return Mock_Result("test_simultaneous");
+}